@@ -30,8 +30,14 @@ _main() {
     elif [ "${_do_umu_only}" = "true" ]; then
         "${umu_builder_dir}/build.sh" || _failure "Building umu-run failed."
     elif [ "${_do_build}" = "true" ]; then
-        _sources || _failure "Failed to prepare sources."
-        _patch proton wine || _failure "Failed to apply patches."
+        if _patched_sources_current; then
+            _message "Proton is already patched with this patch series, leaving its files untouched."
+            _sources protonfixes || _failure "Failed to prepare sources."
+        else
+            _sources || _failure "Failed to prepare sources."
+            _patch proton wine || _failure "Failed to apply patches."
+            _patch_commit "${srcdir}" "$(_patch_key)" protonfixes || _failure "Failed to record the patched sources."
+        fi
         _build || _failure "Build failed."
         { [ "${_do_install}" = "true" ] && _install ; } || _failure "Install failed."
     fi
@@ -49,6 +55,7 @@ _parse_args() {
     _do_cleanbuild=false
     _do_umu_only=false
     _do_rearchive=false
+    _do_compare_archive=false
 
     while [[ $# -gt 0 ]]; do
         case $1 in
@@ -58,6 +65,7 @@ _parse_args() {
             cleanbuild) _do_cleanbuild=true ;;
             umu-only) _do_umu_only=true ;;
             rearchive) _do_rearchive=true ;;
+            compare-archive) _do_compare_archive=true ;;
             *) _warning "Unknown option: $1" ;;
         esac
         shift
@@ -127,7 +135,7 @@ _build() {
         make clean
     }
 
-    make -j1 redist || _failure "Build failed."
+    make -j"${CPUs}" redist || _failure "Build failed."
 
     _create_archive
 }
@@ -150,8 +158,13 @@ _create_archive() {
         cd "${builddir}"
     fi
 
+    # One xz stream per block of files, cached by content, so only blocks
+    # with changed files (usually just umu-run's) are compressed again
     _message "Creating archive: ${pkgname}.tar.xz"
-    XZ_OPT="-9 -T0" tar -Jcf "${build_out_dir}"/"${pkgname}".tar.xz --numeric-owner --owner=0 --group=0 --null "${buildname}" &&
+    python3 "${umu_builder_dir}/lib/blocktar.py" -C "${builddir}" "${buildname}" \
+        -o "${build_out_dir}"/"${pkgname}".tar.xz \
+        --cache "${scriptdir}/.cache/archive-blocks" \
+        $([ "${_do_compare_archive}" = "true" ] && echo --compare) &&
     sha512sum "${build_out_dir}"/"${pkgname}".tar.xz > "${build_out_dir}"/"${pkgname}".sha512sum &&
         _message "${pkgname}.tar.xz is now ready in the build_tarballs directory"
 }
@@ -213,8 +226,15 @@ _patch() {
                 cd - || return 1
             fi
 
-            # Update CPU count in makefiles
+            # Update CPU count in makefiles. Sub-makes lose their own -j so
+            # they share the top-level make's job server instead of each
+            # running $CPUs jobs; only the make started in the container
+            # (CONTAINER=1), which the job server cannot reach, keeps it.
+            # ninja, which cannot join it, backs off under load.
             find "${target_dir}"/make/*mk "${target_dir}"/Makefile.in -execdir sed -i \
+                -e "/CONTAINER=1/!s/\(\$\$*(MAKE)\) -j\$\$*(\(J\|SUBJOBS\))/\1/g" \
+                -e "/CONTAINER=1/!s/\(\$\$*(MAKE)\) \$\$*(filter -j%,\$\$*(MAKEFLAGS))/\1/g" \
+                -e "s/\(ninja .*-j\)[\$]*(SUBJOBS)/\1$CPUs -l$CPUs/g" \
                 -e "s/[\$]*(SUBJOBS)/$CPUs/g" \
                 -e "s/J = \$(patsubst -j%,%,\$(filter -j%,\$(MAKEFLAGS)))/J = $CPUs/" \
                 -e "s/J := \$(shell nproc)/J := $CPUs/" \
@@ -224,10 +244,42 @@ _patch() {
     return 0
 }
 ##############################################
+# Patch cache
+##############################################
+# The base commit, the patch series and the rest of what _patch does; the
+# patched tree is committed with this key so that an unchanged tree is not
+# reset and patched again, which would touch every patched file
+_patch_key() {
+    local base ref
+
+    # The remote branch or tag first: a bare name may be a local branch
+    for ref in "origin/${protontag}" "refs/tags/${protontag}" "${protontag}"; do
+        base=$(git -C "${srcdir}" rev-parse -q --verify "${ref}^{commit}" 2>/dev/null) && break
+    done
+    [ -n "${base}" ] || return 1
+
+    {
+        echo "base=${base}"
+        echo "protonurl=${protonurl}"
+        echo "cpus=${CPUs}"
+        echo "recipe=$(declare -f _patch | sha256sum | cut -c1-16)"
+        _patch_series "${patchdir}/proton"
+        _patch_series "${patchdir}/wine"
+    } | sha256sum | cut -c1-16
+}
+
+_patched_sources_current() {
+    local key
+    key=$(_patch_key) || return 1
+    # protonfixes is synced in on every build
+    _patched_at "${srcdir}" "${key}" protonfixes
+}
+##############################################
 # Source preparation
 ##############################################
 _sources() {
-    local components=("proton" "protonfixes")
+    local components=("$@")
+    [ ${#components[@]} -eq 0 ] && components=("proton" "protonfixes")
 
     cd "${scriptdir}" || _failure "Couldn't change to script directory."
 
@@ -260,6 +312,7 @@ _help() {
     _message "  no-bundle-umu Don't build and bundle umu-run with Proton"
     _message "  umu-only      Only build the static umu-run self-extracting executable"
     _message "  rearchive     Just re-bundle umu-run and proton into the final tarball. You must have already built proton to use this, but umu will be rebuilt."
+    _message "  compare-archive Also time a single-stream 'tar -J' of the tarball, to compare size and time"
     echo ""
     _message "No arguments grabs sources, patches, builds, and installs"
 
@@ -274,6 +327,7 @@ _print_config() {
     _message "  clean build: ${_do_cleanbuild}"
     _message "  umu only: ${_do_umu_only}"
     _message "  rearchive: ${_do_rearchive}"
+    _message "  compare archive: ${_do_compare_archive}"
 }
 ##############################################
 # Run
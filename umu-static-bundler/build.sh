@@ -17,15 +17,24 @@ readonly WORK_DIR="${PROJECT_ROOT}/work"
 readonly BUILD_DIR="${PROJECT_ROOT}/build"
 readonly CACHE_DIR="${THIRD_PARTY_DIR}/cache"
 readonly CACHE_STATE="${CACHE_DIR}/build_state.txt"
+readonly STAGE_CACHE_DIR="${CACHE_DIR}/stages"
+readonly IMPORT_TRACE="${WORK_DIR}/import-trace.txt"
 readonly DOCKER_IMAGE="umu-static-builder:latest"
+readonly DEPS_IMAGE_NAME="umu-static-deps"
 
 # Import utilities
 source "${PROJECT_ROOT}/lib/messaging.sh"
 source "${PROJECT_ROOT}/lib/git-utils.sh"
+source "${PROJECT_ROOT}/lib/stage-cache.sh"
+source "${PROJECT_ROOT}/lib/steps.sh"
+
+# Bump when a stage's recipe below changes in a way its key does not cover
+readonly STAGE_CACHE_VERSION=2
 
 # Source versions
 readonly PYTHON_VERSION="3.13.2"
 readonly STATIC_PYTHON_URL="https://github.com/indygreg/python-build-standalone/releases/download/20250212/cpython-${PYTHON_VERSION}+20250212-x86_64-unknown-linux-musl-install_only_stripped.tar.gz"
+readonly PYTHON_SOURCE_URL="https://www.python.org/ftp/python/${PYTHON_VERSION}/Python-${PYTHON_VERSION}.tar.xz"
 readonly LIBARCHIVE_VERSION="3.7.7"
 readonly LIBARCHIVE_URL="https://github.com/libarchive/libarchive/releases/download/v${LIBARCHIVE_VERSION}/libarchive-${LIBARCHIVE_VERSION}.tar.gz"
 readonly ZSTD_VERSION="1.5.7"
@@ -37,6 +46,10 @@ parse_args() {
     local clean_build=false
     local skip_docker_build=false
     local keep_work=false
+    local python_from_source=false
+    local wrapper_perf=false
+    local tune_payload=false
+    local check_reproducible=false
 
     while [[ $# -gt 0 ]]; do
         case $1 in
@@ -49,6 +62,18 @@ parse_args() {
             keep-work)
                 keep_work=true
                 ;;
+            python-from-source)
+                python_from_source=true
+                ;;
+            wrapper-perf)
+                wrapper_perf=true
+                ;;
+            tune-payload)
+                tune_payload=true
+                ;;
+            check-reproducible)
+                check_reproducible=true
+                ;;
             help)
                 show_help
                 exit 0
@@ -62,7 +87,7 @@ parse_args() {
         shift
     done
 
-    echo "${clean_build}:${skip_docker_build}:${keep_work}"
+    echo "${clean_build}:${skip_docker_build}:${keep_work}:${python_from_source}:${wrapper_perf}:${tune_payload}:${check_reproducible}"
 }
 
 show_help() {
@@ -72,25 +97,46 @@ Usage: $0 [options]
 Build a static executable bundled with Python
 
 Options:
-  clean           Clean all build artifacts before building
+  clean           Clean all build artifacts and cached stages before building
   skip-docker-build Skip rebuilding the Docker image
   keep-work      Keep work directory after successful build
+  python-from-source Build CPython from source with mimalloc, PGO and LTO
+                 instead of using the prebuilt interpreter
+  wrapper-perf   Build the wrapper with the -O2/LTO/PGO profile instead of -Oz
+  tune-payload   Pick the payload's zstd settings by packing and extracting
+                 candidates; PAYLOAD_TUNE_WEIGHT trades extraction time (0)
+                 against size (1), default 0.5. Results in
+                 build/payload-tune.json
+  check-reproducible Build the Docker stages twice, ignoring their cache,
+                 and fail unless both builds are byte-identical
   help           Show this help message
+
+Environment:
+  PAYLOAD_BUDGET Fail when the compressed payload is larger than this many
+                 bytes (K, M and G suffixes work). build/payload-report.txt
+                 shows what the bytes are spent on
+  SOURCE_MIRROR  Fetch downloads and git repositories from this base URL
+                 (e.g. file:///srv/mirror) instead; https://host/path is
+                 looked up as \${SOURCE_MIRROR}/host/path
 EOF
 }
 
 prepare_directories() {
-    local clean_build="$1"
-
-    if [[ "${clean_build}" == "true" ]]; then
-        _message "Cleaning build environment..."
-        rm -rf "${BUILD_DIR}"
-    fi
-
     rm -rf "${WORK_DIR}"
     mkdir -p "${WORK_DIR}" "${BUILD_DIR}" "${CACHE_DIR}"
 }
 
+# Where to fetch a URL from, honouring SOURCE_MIRROR
+_source_url() {
+    local url="$1"
+
+    if [[ -n "${SOURCE_MIRROR:-}" ]]; then
+        echo "${SOURCE_MIRROR%/}/${url#*://}"
+    else
+        echo "${url}"
+    fi
+}
+
 cached_download() {
     local url="$1"
     local output="$2"
@@ -103,7 +149,7 @@ cached_download() {
     fi
 
     _message "Downloading $(basename "${url}")..."
-    if ! curl -L "${url}" -o "${tmp_file}"; then
+    if ! curl -L "$(_source_url "${url}")" -o "${tmp_file}"; then
         rm -f "${tmp_file}"
         _error "Failed to download $(basename "${url}")"
         return 1
@@ -118,59 +164,165 @@ cached_download() {
     fi
 }
 
-_check_cache_state() {
-    local current_state
+# Each stage's key covers its own inputs and the keys of the stages it
+# builds on, so a change only rebuilds the stages downstream of it
+_compute_stage_keys() {
+    SOURCES_KEY=$(_stage_key sources << EOF
+umu_url=${UMU_LAUNCHER_URL}
+umu_version=${UMU_LAUNCHER_VERSION}
+patches=$(_hash_paths "${PATCHES_DIR}")
+EOF
+)
 
-    # Add build configuration to cache state
-    current_state=$(cat << EOF
-static_python_url=${STATIC_PYTHON_URL}
+    # The import trace runs umu-launcher's tests, so the cleaned
+    # distribution depends on its sources too
+    local python_origin="static_python_url=${STATIC_PYTHON_URL}"
+    if [[ "${PYTHON_FROM_SOURCE}" == "true" ]]; then
+        python_origin="python_source_url=${PYTHON_SOURCE_URL}"
+        python_origin+=$'\n'"dockerfile=$(_hash_paths "${BUILDER_DIR}/docker/Dockerfile")"
+    fi
+    PYTHON_KEY=$(_stage_key python << EOF
+${python_origin}
+sources=${SOURCES_KEY}
+python_builder=$(_hash_paths "${BUILDER_DIR}/python")
+EOF
+)
+
+    # The prebuilt zstd and libarchive image, tagged with this key
+    DEPS_KEY=$(_stage_key deps << EOF
 libarchive_version=${LIBARCHIVE_VERSION}
 zstd_version=${ZSTD_VERSION}
-umu_version=${UMU_LAUNCHER_VERSION}
-compiler_flags=$(grep '^CFLAGS' "${BUILDER_DIR}/docker/Makefile")
-linker_flags=$(grep '^LDFLAGS' "${BUILDER_DIR}/docker/Makefile")
+recipe=$(_hash_paths "${BUILDER_DIR}/docker/Dockerfile.deps")
+EOF
+)
+    DEPS_IMAGE="${DEPS_IMAGE_NAME}:${DEPS_KEY}"
+
+    local toolchain
+    toolchain=$(_hash_paths "${BUILDER_DIR}/docker")
+    UMU_KEY=$(_stage_key umu << EOF
+sources=${SOURCES_KEY}
+toolchain=${toolchain}
+source_date_epoch=${SOURCE_DATE_EPOCH:-}
 EOF
 )
 
-    # Add hashes for git repositories in third_party
-    while IFS= read -r repo_dir; do
-        local repo_name
-        repo_name=$(basename "${repo_dir}")
-        if [[ -d "${repo_dir}/.git" ]]; then
-            local repo_hash
-            repo_hash=$(cd "${repo_dir}" && git rev-parse HEAD)
-            current_state+=$'\n'"${repo_name}_commit=${repo_hash}"
-        fi
-    done < <(find "${THIRD_PARTY_DIR}" -maxdepth 1 -type d -not -name "cache" -not -name "third_party")
+    # The wrapper embeds a checksum of umu-launcher's version file
+    WRAPPER_KEY=$(_stage_key wrapper << EOF
+wrapper=$(_hash_paths "${WRAPPER_DIR}")
+toolchain=${toolchain}
+libarchive_version=${LIBARCHIVE_VERSION}
+zstd_version=${ZSTD_VERSION}
+python_version=${PYTHON_VERSION}
+python_malloc=${PYTHON_MALLOC:-}
+wrapper_profile=${WRAPPER_PROFILE:-}
+umu=${UMU_KEY}
+EOF
+)
 
-    # Add hashes for project files
-    current_state+=$'\n'"patches_hash=$(find "${PATCHES_DIR}" -type f -exec sha256sum {} + 2>/dev/null | sort | sha256sum | cut -d' ' -f1)"
-    current_state+=$'\n'"builder_hash=$(find "${BUILDER_DIR}" -type f -exec sha256sum {} + | sort | sha256sum | cut -d' ' -f1)"
-    current_state+=$'\n'"wrapper_hash=$(find "${WRAPPER_DIR}" -type f -exec sha256sum {} + | sort | sha256sum | cut -d' ' -f1)"
+    # A tuned payload is chosen by timing the wrapper's extraction code
+    local packer="packer=$(_hash_paths "${WRAPPER_DIR}/tools")"
+    if [[ -n "${PAYLOAD_TUNE:-}" ]]; then
+        packer+=$'\n'"payload_tune=${PAYLOAD_TUNE}"
+        packer+=$'\n'"wrapper=$(_hash_paths "${WRAPPER_DIR}")"
+    fi
+    PAYLOAD_KEY=$(_stage_key payload << EOF
+python=${PYTHON_KEY}
+umu=${UMU_KEY}
+toolchain=${toolchain}
+${packer}
+libarchive_version=${LIBARCHIVE_VERSION}
+zstd_version=${ZSTD_VERSION}
+source_date_epoch=${SOURCE_DATE_EPOCH:-}
+EOF
+)
+}
 
-    if [[ ! -f "${CACHE_STATE}" ]] || [[ "${current_state}" != "$(cat "${CACHE_STATE}")" ]]; then
-        echo "${current_state}" > "${CACHE_STATE}"
-        return 1
+# Timestamp for the Docker stages' outputs unless SOURCE_DATE_EPOCH is set:
+# the pinned umu-launcher commit's, which the stage keys already cover
+_umu_commit_time() {
+    local repo="${THIRD_PARTY_DIR}/umu-launcher"
+
+    if [[ "$(git -C "${repo}" rev-parse HEAD 2>/dev/null)" != "${UMU_LAUNCHER_VERSION}"* ]]; then
+        (_repo_updater "${PROJECT_ROOT}" "${repo}" "${UMU_LAUNCHER_URL}" "${UMU_LAUNCHER_VERSION}") >&2
     fi
-    return 0
+    git -C "${repo}" log -1 --format=%ct
+}
+
+# The last assembled executable is current if it came from the same
+# wrapper and payload
+_check_cache_state() {
+    [[ -x "${BUILD_DIR}/umu-run" && -f "${CACHE_STATE}" ]] &&
+        [[ "${WRAPPER_KEY}:${PAYLOAD_KEY}" == "$(cat "${CACHE_STATE}")" ]]
+}
+
+# Run the umu-launcher test suite and a scripted launch under the unpruned
+# interpreter, recording every module they import. The cleaner follows
+# those imports as well as the sources' and fails if one of them is removed
+# anyway. The trace stays in the work directory for later stages.
+_record_import_trace() {
+    local python="${CACHE_DIR}/cleanup_python${PYTHON_VERSION}/bin/python3"
+    local umu_dir="${WORK_DIR}/umu-launcher"
+    local pythonpath="${umu_dir}"
+    local launch_dir="${WORK_DIR}/trace-launch"
+    local subproject stub status=0
+
+    # Vendored dependencies, some with a src/ layout
+    for subproject in "${umu_dir}"/subprojects/*/; do
+        [[ -d "${subproject}src" ]] && subproject="${subproject}src"
+        pythonpath+=":${subproject%/}"
+    done
+
+    # The launch runs umu-run's whole setup against a home of its own: a
+    # runtime that is never updated and whose entry point, like Proton, is a
+    # stub that exits at once
+    rm -rf "${launch_dir}"
+    mkdir -p "${launch_dir}/home" "${launch_dir}/proton" \
+        "${launch_dir}/data/umu/steamrt3"
+    for stub in proton/proton data/umu/steamrt3/umu \
+            data/umu/steamrt3/_v2-entry-point; do
+        printf '#!/bin/sh\nexit 0\n' > "${launch_dir}/${stub}"
+        chmod +x "${launch_dir}/${stub}"
+    done
+
+    _message "Recording runtime imports..."
+    (cd "${umu_dir}" && PYTHONPATH="${pythonpath}" UMU_LOG=0 \
+        HOME="${launch_dir}/home" XDG_DATA_HOME="${launch_dir}/data" \
+        XDG_CACHE_HOME="${launch_dir}/cache" \
+        XDG_CONFIG_HOME="${launch_dir}/config" \
+        "${python}" "${BUILDER_DIR}/python/import_trace.py" record \
+        -o "${IMPORT_TRACE}" -- \
+        "${python}" -m unittest discover -s umu -p 'umu_test*.py' ';;' \
+        env GAMEID=none PROTONPATH="${launch_dir}/proton" \
+        UMU_RUNTIME_UPDATE=0 "${python}" -m umu /bin/true) || status=$?
+    rm -rf "${launch_dir}"
+    return "${status}"
 }
 
 _cleanup_python_dist() {
     local original_size
+    local trace_args=()
     original_size=$(du -sh "${WORK_DIR}/python" | cut -f1)
     _message "Initial Python distribution size: ${original_size}"
 
+    if _record_import_trace; then
+        trace_args=(--import-trace "${IMPORT_TRACE}")
+    else
+        _warning "No import trace recorded, pruning by static analysis only"
+    fi
+
     _message "Running Python distribution cleaner..."
     "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}/bin/python3" "${BUILDER_DIR}/python/cleaner.py" \
         "${WORK_DIR}/python" \
         "${WORK_DIR}/umu-launcher" \
         --config "${BUILDER_DIR}/python/config.py" \
+        --extra-source "${BUILDER_DIR}/python/pyb_trace.py" \
+        --extra-source "${BUILDER_DIR}/python/pyb_importtime.py" \
+        --extra-source "${BUILDER_DIR}/python/pyb_stderr.py" \
+        --cache-dir "${CACHE_DIR}/cleaner" \
+        --strip-comments \
+        "${trace_args[@]}" \
         ${DEBUG:+--debug} || _failure "Python distribution cleanup failed"
 
-    # Metadata cleanup
-    find "${WORK_DIR}/python" -type f -name "*.py" \
-        -exec sed -i '/^#.*coding/d;/^#.*Author/d;/^#.*Copyright/d' {} +
-
     local final_size
     final_size=$(du -sh "${WORK_DIR}/python" | cut -f1)
 
@@ -178,13 +330,15 @@ _cleanup_python_dist() {
     _message "Size reduced from ${original_size} to ${final_size}"
 }
 
-prepare_sources() {
-    # Download dependencies
-    cached_download "${STATIC_PYTHON_URL}" "${CACHE_DIR}/python-standalone-${PYTHON_VERSION}.tar.gz"
-    cached_download "${LIBARCHIVE_URL}" "${CACHE_DIR}/libarchive-${LIBARCHIVE_VERSION}.tar.gz"
-    cached_download "${ZSTD_URL}" "${CACHE_DIR}/zstd-${ZSTD_VERSION}.tar.zst"
+# Patched umu-launcher sources, in ${WORK_DIR}/umu-launcher
+stage_sources() {
+    [[ -d "${WORK_DIR}/umu-launcher" ]] && return 0
+
+    if _stage_restore sources "${SOURCES_KEY}" "${WORK_DIR}"; then
+        _message "Using cached umu-launcher sources"
+        return 0
+    fi
 
-    # Prepare UMU launcher
     _message "Preparing umu-launcher sources..."
     _repo_updater "${PROJECT_ROOT}" "${THIRD_PARTY_DIR}/umu-launcher" "${UMU_LAUNCHER_URL}" "${UMU_LAUNCHER_VERSION}"
     cp -r "${THIRD_PARTY_DIR}/umu-launcher" "${WORK_DIR}/"
@@ -195,51 +349,127 @@ prepare_sources() {
         sed -i 's|\(__version__ = "[^"]*\)|\1.99|g' "${WORK_DIR}/umu-launcher/umu/__init__.py" # Add a unique version identifier here
     fi
 
-    # Setup Python environment for cleanup
+    _stage_save sources "${SOURCES_KEY}" "${WORK_DIR}" umu-launcher
+}
+
+# The prebuilt interpreter, which runs the cleaner and is bundled unless
+# building from source
+_prepare_cleanup_python() {
+    cached_download "${STATIC_PYTHON_URL}" "${CACHE_DIR}/python-standalone-${PYTHON_VERSION}.tar.gz"
+
     if [[ ! -d "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}" ]]; then
         _message "Extracting Python distribution..."
         mkdir -p "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}"
         tar xf "${CACHE_DIR}/python-standalone-${PYTHON_VERSION}.tar.gz" \
             -C "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}" --strip-components=1
     fi
+}
 
-    # Prepare Python distribution
-    mkdir -p "${WORK_DIR}/python"
-    rsync -a "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}"/* "${WORK_DIR}/python"
-    _cleanup_python_dist
+# The cleaned Python distribution, in ${WORK_DIR}/python
+stage_python() {
+    local docker_context="$1"
 
-    # Extract build dependencies
-    _message "Extracting libarchive..."
-    mkdir -p "${WORK_DIR}/libarchive"
-    tar xf "${CACHE_DIR}/libarchive-${LIBARCHIVE_VERSION}.tar.gz" \
-        -C "${WORK_DIR}/libarchive" --strip-components=1
+    if _stage_restore python "${PYTHON_KEY}" "${WORK_DIR}"; then
+        _message "Using cached Python distribution"
+        return 0
+    fi
 
-    _message "Extracting zstd..."
-    mkdir -p "${WORK_DIR}/zstd"
-    tar xf "${CACHE_DIR}/zstd-${ZSTD_VERSION}.tar.zst" \
-        -C "${WORK_DIR}/zstd" --strip-components=1
+    stage_sources
+    _prepare_cleanup_python
 
-    # Copy wrapper sources
-    _message "Copying wrapper sources..."
-    cp -r "${WRAPPER_DIR}" "${WORK_DIR}/" || _failure "Failed to copy wrapper sources"
+    if [[ "${PYTHON_FROM_SOURCE}" == "true" ]]; then
+        cached_download "${PYTHON_SOURCE_URL}" "${CACHE_DIR}/Python-${PYTHON_VERSION}.tar.xz"
+        build_python_from_source "${docker_context}"
+    else
+        mkdir -p "${WORK_DIR}/python"
+        rsync -a "${CACHE_DIR}/cleanup_python${PYTHON_VERSION}"/* "${WORK_DIR}/python"
+        _cleanup_python_dist
+    fi
+
+    local outputs=(python)
+    [[ -f "${IMPORT_TRACE}" ]] && outputs+=("$(basename "${IMPORT_TRACE}")")
+    _stage_save python "${PYTHON_KEY}" "${WORK_DIR}" "${outputs[@]}"
+}
+
+# Download a source tarball and unpack it into ${WORK_DIR}/deps/<name>, the
+# context of the dependency image
+# Usage: prepare_build_dep <name> <url> <cached file>
+prepare_build_dep() {
+    local name="$1"
+    local url="$2"
+    local archive="$3"
+
+    cached_download "${url}" "${archive}"
+
+    _message "Extracting ${name}..."
+    mkdir -p "${WORK_DIR}/deps/${name}"
+    tar xf "${archive}" -C "${WORK_DIR}/deps/${name}" --strip-components=1
+}
+
+# Build the zstd and libarchive image, unless one with the same key exists.
+# Editing the wrapper or the build scripts does not touch it.
+build_deps_image() {
+    _message "Building zstd ${ZSTD_VERSION} and libarchive ${LIBARCHIVE_VERSION}..."
+    if ! docker buildx build --progress=plain -t "${DEPS_IMAGE}" \
+            -f "${BUILDER_DIR}/docker/Dockerfile.deps" "${WORK_DIR}/deps"; then
+        _failure "Dependency image build failed"
+    fi
+    rm -rf "${WORK_DIR}/deps"
 }
 
 prepare_docker_context() {
-    local docker_context="${WORK_DIR}/docker_context"
+    local docker_context="$1"
     mkdir -p "${docker_context}/build"
 
-    # Copy build dependencies
-    cp -r "${WORK_DIR}/libarchive" "${docker_context}/build/" || _failure "Failed to copy libarchive"
-    cp -r "${WORK_DIR}/zstd" "${docker_context}/build/" || _failure "Failed to copy zstd"
-    cp -r "${WORK_DIR}/wrapper" "${docker_context}/build/" || _failure "Failed to copy wrapper sources"
+    # Wrapper sources, built in the container from the work directory
+    _message "Copying wrapper sources..."
+    cp -r "${WRAPPER_DIR}" "${WORK_DIR}/" || _failure "Failed to copy wrapper sources"
 
     # Copy build system files
     mkdir -p "${docker_context}/build/lib"
     cp "${BUILDER_DIR}/docker/docker-build.sh" "${docker_context}/build/lib/" || _failure "Failed to copy build script"
     cp "${BUILDER_DIR}/docker/Makefile" "${docker_context}/build/lib/" || _failure "Failed to copy makefile"
     cp "${PROJECT_ROOT}/lib/messaging.sh" "${docker_context}/build/lib/" || _failure "Failed to copy messaging utilities"
+    cp "${BUILDER_DIR}/docker/zip_normalize.py" "${docker_context}/build/lib/" || _failure "Failed to copy zip normalizer"
+    cp "${BUILDER_DIR}/python/pyb_trace.py" "${BUILDER_DIR}/python/pyb_trace.pth" "${docker_context}/build/lib/" || _failure "Failed to copy trace helper"
+    cp "${BUILDER_DIR}/python/pyb_importtime.py" "${docker_context}/build/lib/" || _failure "Failed to copy import profile aggregator"
+    cp "${BUILDER_DIR}/python/pyb_malloc.pth" "${docker_context}/build/lib/" || _failure "Failed to copy allocator hook"
+    cp "${BUILDER_DIR}/python/pyb_stderr.py" "${BUILDER_DIR}/python/pyb_stderr.pth" "${docker_context}/build/lib/" || _failure "Failed to copy stderr hook"
+    cp "${BUILDER_DIR}/python/payload_report.py" "${BUILDER_DIR}/python/import_trace.py" "${docker_context}/build/lib/" || _failure "Failed to copy payload report"
+}
+
+# Build the cpython Docker target and export its /opt/python as the
+# distribution to bundle, then compare it against the prebuilt interpreter
+build_python_from_source() {
+    local docker_context="$1"
+    local prebuilt="${CACHE_DIR}/cleanup_python${PYTHON_VERSION}/bin/python3"
+
+    _message "Preparing CPython ${PYTHON_VERSION} sources..."
+    mkdir -p "${docker_context}/build/cpython" "${docker_context}/build/pgo"
+    tar xf "${CACHE_DIR}/Python-${PYTHON_VERSION}.tar.xz" \
+        -C "${docker_context}/build/cpython" --strip-components=1
+    cp "${BUILDER_DIR}/python/interp_bench.py" "${docker_context}/build/pgo/"
+    cp -r "${WORK_DIR}/umu-launcher" "${docker_context}/build/pgo/"
+
+    _message "Building CPython with mimalloc, PGO and LTO..."
+    rm -rf "${WORK_DIR}/python"
+    if ! docker buildx build --progress=plain --target cpython \
+            --output "type=local,dest=${WORK_DIR}/python" \
+            -f "${BUILDER_DIR}/docker/Dockerfile" "${docker_context}"; then
+        _failure "CPython build failed"
+    fi
+    rm -rf "${docker_context}/build/cpython" "${docker_context}/build/pgo"
+
+    # Measured before cleaning, which may prune modules the benchmark uses
+    _message "Comparing against the prebuilt interpreter..."
+    "${prebuilt}" "${BUILDER_DIR}/python/interp_bench.py" \
+        --umu "${WORK_DIR}/umu-launcher" \
+        --python "${prebuilt}" \
+        --python "${WORK_DIR}/python/bin/python3,PYTHONMALLOC=${PYTHON_MALLOC}" \
+        -o "${BUILD_DIR}/python-bench.json" ||
+        _warning "Interpreter benchmark failed"
 
-    echo "${docker_context}"
+    _cleanup_python_dist
 }
 
 build_docker_image() {
@@ -252,7 +482,9 @@ build_docker_image() {
     fi
 
     _message "Building Docker image..."
-    if ! docker buildx build --progress=plain -t ${DOCKER_IMAGE} -f "${BUILDER_DIR}/docker/Dockerfile" "${docker_context}"; then
+    if ! docker buildx build --progress=plain -t ${DOCKER_IMAGE} \
+            --build-arg DEPS_IMAGE="${DEPS_IMAGE}" \
+            -f "${BUILDER_DIR}/docker/Dockerfile" "${docker_context}"; then
         _error "Docker build failed"
         rm -rf "${docker_context}"
         return 1
@@ -262,7 +494,9 @@ build_docker_image() {
 }
 
 run_docker_build() {
-    _message "Running build in Docker container..."
+    local stages="$1"
+
+    _message "Running build in Docker container (${stages})..."
 
     if ! docker run --rm -i \
         --user "$(id -u):$(id -g)" \
@@ -270,11 +504,106 @@ run_docker_build() {
         -v "${BUILD_DIR}:/build/output:rw" \
         -e WORK_DIR=/build/work \
         -e BUILD_DIR=/build/output \
+        -e BUILD_STAGES="${stages}" \
+        -e PYTHON_VERSION="${PYTHON_VERSION}" \
+        -e SOURCE_DATE_EPOCH="${SOURCE_DATE_EPOCH}" \
+        ${PYTHON_MALLOC:+-e PYTHON_MALLOC="${PYTHON_MALLOC}"} \
+        ${WRAPPER_PROFILE:+-e WRAPPER_PROFILE="${WRAPPER_PROFILE}"} \
+        ${PAYLOAD_TUNE:+-e PAYLOAD_TUNE="${PAYLOAD_TUNE}"} \
         "${DOCKER_IMAGE}"; then
         _failure "Docker build failed"
     fi
 }
 
+_docker_stage_key() {
+    case "$1" in
+        umu) echo "${UMU_KEY}" ;;
+        wrapper) echo "${WRAPPER_KEY}" ;;
+        payload) echo "${PAYLOAD_KEY}" ;;
+    esac
+}
+
+# Stage outputs the Docker build leaves in ${WORK_DIR}
+_docker_stage_outputs() {
+    case "$1" in
+        umu) echo "umu-launcher/builddir/umu-run umu-launcher/umu/umu_version.json" ;;
+        wrapper) echo "umu-run" ;;
+        payload) echo "archive.tar.zst payload-report.txt payload-report.json" ;;
+    esac
+}
+
+# Rebuild every Docker stage from clean copies of the same inputs, and fail
+# unless the wrapper and payload come out byte-identical
+verify_reproducible() {
+    local first="${WORK_DIR}/first-build"
+    local output
+
+    _message "Rebuilding to check that the build is reproducible..."
+    mkdir -p "${first}"
+    mv "${WORK_DIR}/umu-run" "${WORK_DIR}/archive.tar.zst" "${first}/"
+    rm -rf "${WORK_DIR}/umu-launcher" "${WORK_DIR}/wrapper"
+    stage_sources
+    cp -r "${WRAPPER_DIR}" "${WORK_DIR}/" || _failure "Failed to copy wrapper sources"
+
+    run_docker_build "umu wrapper payload"
+
+    for output in umu-run archive.tar.zst; do
+        if ! cmp "${first}/${output}" "${WORK_DIR}/${output}"; then
+            _failure "Build is not reproducible: ${output} differs between two builds"
+        fi
+    done
+    rm -rf "${first}"
+    _message "Both builds are byte-identical"
+}
+
+# Fail when the compressed payload is over PAYLOAD_BUDGET
+# Usage: check_payload_budget <archive bytes>
+check_payload_budget() {
+    local archive_size="$1"
+    local budget
+
+    [[ -n "${PAYLOAD_BUDGET:-}" ]] || return 0
+    budget=$(numfmt --from=iec "${PAYLOAD_BUDGET}") ||
+        _failure "PAYLOAD_BUDGET is not a size: ${PAYLOAD_BUDGET}"
+
+    if (( archive_size > budget )); then
+        _failure "The payload is $(numfmt --to=iec "${archive_size}") compressed, over its budget of ${PAYLOAD_BUDGET} (see ${BUILD_DIR}/payload-report.txt)"
+    fi
+    _message "Payload within budget: $(numfmt --to=iec "${archive_size}") of ${PAYLOAD_BUDGET}"
+}
+
+# Put the payload report next to the executable and show its summary
+publish_payload_report() {
+    local report
+
+    for report in payload-report.txt payload-report.json; do
+        [[ -f "${WORK_DIR}/${report}" ]] && cp "${WORK_DIR}/${report}" "${BUILD_DIR}/"
+    done
+    if [[ -f "${BUILD_DIR}/payload-report.txt" ]]; then
+        sed '/^$/q' "${BUILD_DIR}/payload-report.txt"
+        _message "Payload report: ${BUILD_DIR}/payload-report.txt"
+    fi
+}
+
+# The wrapper followed by the payload and its size, as the wrapper expects
+assemble_executable() {
+    local archive="${WORK_DIR}/archive.tar.zst"
+    local output="${BUILD_DIR}/umu-run"
+    local archive_size
+
+    _message "Assembling final executable..."
+    archive_size=$(stat -c%s "${archive}")
+    if ! { cat "${WORK_DIR}/umu-run" "${archive}" &&
+            printf "%020d" "${archive_size}"; } > "${output}.tmp"; then
+        rm -f "${output}.tmp"
+        _failure "Failed to combine wrapper with archive"
+    fi
+    chmod +x "${output}.tmp"
+    mv "${output}.tmp" "${output}"
+
+    echo "${WRAPPER_KEY}:${PAYLOAD_KEY}" > "${CACHE_STATE}"
+}
+
 cleanup() {
     local keep_work="$1"
     
@@ -284,25 +613,120 @@ cleanup() {
 }
 
 main() {
-    IFS=':' read -r clean_build skip_docker_build keep_work <<< "$(parse_args "$@")"
+    IFS=':' read -r clean_build skip_docker_build keep_work PYTHON_FROM_SOURCE WRAPPER_PERF tune_payload check_reproducible <<< "$(parse_args "$@")"
+
+    # The source build includes mimalloc, which CPython only uses when
+    # asked; the wrapper sets PYTHONMALLOC for the bundled interpreter alone
+    if [[ "${PYTHON_FROM_SOURCE}" == "true" ]]; then
+        PYTHON_MALLOC=mimalloc
+    fi
+    if [[ "${WRAPPER_PERF}" == "true" ]]; then
+        WRAPPER_PROFILE=perf
+    fi
+    if [[ "${tune_payload}" == "true" ]]; then
+        PAYLOAD_TUNE="${PAYLOAD_TUNE_WEIGHT:-0.5}"
+    fi
 
     if [[ "${clean_build}" == "true" ]]; then
         _message "Clean build requested, starting fresh..."
-    elif [[ -x "${BUILD_DIR}/umu-run" ]] && _check_cache_state; then
+        rm -rf "${BUILD_DIR}" "${STAGE_CACHE_DIR}" "${CACHE_STATE}"
+    fi
+
+    # git fetches umu-launcher and its submodules through the mirror too
+    if [[ -n "${SOURCE_MIRROR:-}" ]]; then
+        local git_config="${GIT_CONFIG_COUNT:-0}"
+        export "GIT_CONFIG_KEY_${git_config}=url.${SOURCE_MIRROR%/}/.insteadOf"
+        export "GIT_CONFIG_VALUE_${git_config}=https://"
+        export GIT_CONFIG_COUNT=$((git_config + 1))
+    fi
+
+    _compute_stage_keys
+    if [[ "${check_reproducible}" != "true" ]] && _check_cache_state; then
         _message "No changes detected in sources or configurations"
         _message "Existing binary found at: ${BUILD_DIR}/umu-run"
+        check_payload_budget "$((10#$(tail -c 20 "${BUILD_DIR}/umu-run")))"
         return 0
-    else
-        _message "Changes detected or binary doesn't exist, starting fresh..."
     fi
 
-    prepare_directories "${clean_build}"
-    prepare_sources
+    prepare_directories
+
+    local docker_stages=()
+    local stage key
+    for stage in umu wrapper payload; do
+        if [[ "${check_reproducible}" == "true" ]] ||
+                ! _stage_hit "${stage}" "$(_docker_stage_key "${stage}")"; then
+            docker_stages+=("${stage}")
+        fi
+    done
+
+    # Fetch and unpack what the stages to rebuild need, each step as soon
+    # as the ones it needs are done
+    local docker_context="${WORK_DIR}/docker_context"
+    local python_deps=""
+    if [[ ${#docker_stages[@]} -gt 0 ]]; then
+        _message "Rebuilding: ${docker_stages[*]}"
+        if [[ " ${docker_stages[*]} " == *" umu "* ]]; then
+            _step sources "" stage_sources
+        fi
+        if docker image inspect "${DEPS_IMAGE}" > /dev/null 2>&1; then
+            _message "Using cached zstd and libarchive image ${DEPS_IMAGE}"
+        else
+            _step libarchive "" prepare_build_dep libarchive \
+                "${LIBARCHIVE_URL}" "${CACHE_DIR}/libarchive-${LIBARCHIVE_VERSION}.tar.gz"
+            _step zstd "" prepare_build_dep zstd \
+                "${ZSTD_URL}" "${CACHE_DIR}/zstd-${ZSTD_VERSION}.tar.zst"
+            _step deps-image "libarchive zstd" build_deps_image
+        fi
+        _step docker-context "" prepare_docker_context "${docker_context}"
+    fi
+    # Only the payload bundles the Python distribution
+    if [[ " ${docker_stages[*]} " == *" payload "* ]]; then
+        if ! _stage_hit python "${PYTHON_KEY}"; then
+            [[ " ${docker_stages[*]} " == *" umu "* ]] || _step sources "" stage_sources
+            _step cleanup-python "" _prepare_cleanup_python
+            python_deps="sources cleanup-python"
+            if [[ "${PYTHON_FROM_SOURCE}" == "true" ]]; then
+                _step python-source "" cached_download \
+                    "${PYTHON_SOURCE_URL}" "${CACHE_DIR}/Python-${PYTHON_VERSION}.tar.xz"
+                python_deps+=" python-source docker-context"
+            fi
+        fi
+        _step python "${python_deps}" stage_python "${docker_context}"
+    fi
+    _run_steps "${WORK_DIR}/logs"
+
+    # Cached outputs go over the sources, as the wrapper and payload stages
+    # read umu-launcher's build output
+    for stage in umu wrapper payload; do
+        if [[ " ${docker_stages[*]} " != *" ${stage} "* ]]; then
+            _stage_restore "${stage}" "$(_docker_stage_key "${stage}")" "${WORK_DIR}" ||
+                _failure "Failed to restore the cached ${stage} stage"
+            _message "Using cached ${stage} stage"
+        fi
+    done
+
+    if [[ ${#docker_stages[@]} -gt 0 ]]; then
+        if [[ -z "${SOURCE_DATE_EPOCH:-}" ]]; then
+            SOURCE_DATE_EPOCH=$(_umu_commit_time) || _failure "Could not date the umu-launcher commit"
+            export SOURCE_DATE_EPOCH
+        fi
+        build_docker_image "${skip_docker_build}" "${docker_context}" || _failure
+        run_docker_build "${docker_stages[*]}"
+
+        for stage in "${docker_stages[@]}"; do
+            key=$(_docker_stage_key "${stage}")
+            # shellcheck disable=SC2046
+            _stage_save "${stage}" "${key}" "${WORK_DIR}" $(_docker_stage_outputs "${stage}")
+        done
+    fi
+
+    if [[ "${check_reproducible}" == "true" ]]; then
+        verify_reproducible
+    fi
 
-    local docker_context
-    docker_context=$(prepare_docker_context)
-    build_docker_image "${skip_docker_build}" "${docker_context}" || _failure
-    run_docker_build
+    publish_payload_report
+    check_payload_budget "$(stat -c%s "${WORK_DIR}/archive.tar.zst")"
+    assemble_executable
 
     _message "Build completed successfully"
     _message "The executable is located at: ${BUILD_DIR}/umu-run"
@@ -6,106 +6,176 @@ source "/build/lib/messaging.sh"
 
 readonly PYTHON_DIR="${WORK_DIR}/python"
 readonly UMU_DIR="${WORK_DIR}/umu-launcher"
-readonly BUILD_OUTPUT="${BUILD_DIR}/umu-run"
-readonly STAGE_DIR="${WORK_DIR}/stage"
 readonly APP_NAME="umu-run"
+readonly _VERSION_FILE="${UMU_DIR}/umu/umu_version.json"
+readonly STAGED_VERSION="${WORK_DIR}/umu_version.json"
+readonly PAYLOAD_CONTENTS="${WORK_DIR}/payload-contents.tsv"
 
-# Configure umu-launcher
-OLDHOME=${HOME}
-HOME=${BUILD_DIR}
+# build.sh runs only the stages its cache is missing, and assembles the
+# executable from ${WORK_DIR}/umu-run and ${WORK_DIR}/archive.tar.zst
+readonly BUILD_STAGES="${BUILD_STAGES:-umu wrapper payload}"
 
-cd "${UMU_DIR}"
-./configure.sh --user-install
-make
+# Timestamps in the outputs; build.sh passes the pinned umu-launcher
+# commit's, so identical inputs give identical bytes
+export SOURCE_DATE_EPOCH="${SOURCE_DATE_EPOCH:-0}"
 
-HOME=${OLDHOME}
+# umu-launcher's zipapp and version file, in ${UMU_DIR}
+build_umu() {
+    # Configure umu-launcher
+    OLDHOME=${HOME}
+    HOME=${BUILD_DIR}
 
-# Check for version file and stage it
-readonly _VERSION_FILE="${UMU_DIR}/umu/umu_version.json"
-readonly STAGED_VERSION="${WORK_DIR}/umu_version.json"
+    cd "${UMU_DIR}"
+    ./configure.sh --user-install
+    make
+
+    HOME=${OLDHOME}
+
+    # The zipapp records each module's mtime
+    python3 /build/lib/zip_normalize.py "${UMU_DIR}/builddir/umu-run" ||
+        _failure "Failed to normalize the umu-run zipapp"
 
-if [ ! -f "${_VERSION_FILE}" ]; then
-    DATE=$(date)
-    printf '%s %s' "${DATE}" "$(echo -n "${DATE}" | sha512sum -)" > "${_VERSION_FILE}"
-fi
-cp "${_VERSION_FILE}" "${STAGED_VERSION}"
-
-# Build static wrapper
-_message "Building static wrapper..."
-cd "${WORK_DIR}/wrapper" || _failure "No wrapper src dir?"
-
-export BINARY_NAME="umu-run"
-
-# Pass absolute paths to the Makefile for version file handling
-PYTHON_VERSION="$("${PYTHON_DIR}/bin/python" --version | cut -f2 -d' ')" \
-PYTHON_SCRIPT="umu-run" \
-VERSION_FILE="${STAGED_VERSION}" \
-VERSION_FILE_NAME="umu_version.json" \
-make -f /build/lib/Makefile || _failure "Failed to compile wrapper"
-
-mv "${WORK_DIR}/wrapper/umu-run" "${WORK_DIR}/umu-run" && cd "${WORK_DIR}"
-
-# Prepare staging directories with final structure
-_message "Preparing staging directories..."
-mkdir -p "${STAGE_DIR}/python" "${STAGE_DIR}/apps/${APP_NAME}/bin"
-
-# Stage Python distribution
-_message "Staging Python distribution..."
-cp -r "${PYTHON_DIR}"/* "${STAGE_DIR}/python/"
-
-# Stage application files
-_message "Staging application files..."
-cp "${UMU_DIR}/builddir/umu-run" "${STAGE_DIR}/apps/${APP_NAME}/bin/"
-
-# Ensure version file exists in the correct location for the bundle
-cp "${_VERSION_FILE}" "${STAGE_DIR}/apps/${APP_NAME}/"
-
-# Verify staged files
-_message "Verifying staged files..."
-required_files=(
-    "python/bin/python"
-    "python/bin/python3"
-    "apps/${APP_NAME}/bin/umu-run"
-    "apps/${APP_NAME}/umu_version.json"
-)
-
-for file in "${required_files[@]}"; do
-    if [[ ! -f "${STAGE_DIR}/${file}" ]]; then
-        _error "Missing required file: ${file}"
-        rm -rf "${STAGE_DIR}"
-        _failure "Stage verification failed"
+    # Check for version file; the wrapper re-extracts when it changes, so it
+    # follows the sources rather than the time of the build
+    if [ ! -f "${_VERSION_FILE}" ]; then
+        DATE=$(date -u -d "@${SOURCE_DATE_EPOCH}")
+        printf '%s %s' "${DATE}" "$(sha512sum - < "${UMU_DIR}/builddir/umu-run")" > "${_VERSION_FILE}"
+    fi
+}
+
+# The static wrapper, in ${WORK_DIR}/umu-run
+build_wrapper() {
+    cp "${_VERSION_FILE}" "${STAGED_VERSION}"
+
+    _message "Building static wrapper..."
+    cd "${WORK_DIR}/wrapper" || _failure "No wrapper src dir?"
+
+    export BINARY_NAME="umu-run"
+
+    # Pass absolute paths to the Makefile for version file handling
+    PYTHON_VERSION="${PYTHON_VERSION:-$("${PYTHON_DIR}/bin/python" --version | cut -f2 -d' ')}" \
+    PYTHON_SCRIPT="umu-run" \
+    PYTHON_MALLOC="${PYTHON_MALLOC:-}" \
+    VERSION_FILE="${STAGED_VERSION}" \
+    VERSION_FILE_NAME="umu_version.json" \
+    make -f /build/lib/Makefile "${WRAPPER_PROFILE:-all}" || _failure "Failed to compile wrapper"
+
+    mv "${WORK_DIR}/wrapper/umu-run" "${WORK_DIR}/umu-run" && cd "${WORK_DIR}"
+}
+
+# The compressed Python and umu-launcher tree, in ${WORK_DIR}/archive.tar.zst,
+# streamed by tools/pack from where the files already are. With PAYLOAD_TUNE
+# set (a weight between 0, fastest to extract, and 1, smallest), the zstd
+# settings are chosen by tools/tune_payload.py from measured candidates.
+build_payload() {
+    local manifest="${WORK_DIR}/payload.manifest"
+    local app="./apps/${APP_NAME}"
+    local lib_dir file
+
+    _message "Building payload packer..."
+    make -C "${WORK_DIR}/wrapper" -f /build/lib/Makefile tools || _failure "Failed to compile packer"
+
+    # Verify source files
+    _message "Verifying payload sources..."
+    for file in "${PYTHON_DIR}/bin/python" "${PYTHON_DIR}/bin/python3" \
+            "${UMU_DIR}/builddir/umu-run" "${_VERSION_FILE}"; do
+        [[ -f "${file}" ]] || _failure "Missing required file: ${file}"
+    done
+
+    {
+        printf '%s\t%s\n' "${PYTHON_DIR}" ./python
+
+        # The PYB_TRACE helper so Python spans join the wrapper's trace, the
+        # PYB_PROFILE_IMPORTS aggregator (python3 -m pyb_importtime) and the
+        # hook that hands that mode's stderr back, and the hook that keeps
+        # the wrapper's PYTHONMALLOC from other Pythons
+        # (the cleaner removes site-packages, so this recreates it)
+        for lib_dir in "${PYTHON_DIR}"/lib/python3.*/; do
+            [[ -d "${lib_dir}" ]] || continue
+            lib_dir="./python/lib/$(basename "${lib_dir}")/site-packages"
+            for file in pyb_trace.py pyb_trace.pth pyb_importtime.py \
+                    pyb_stderr.py pyb_stderr.pth pyb_malloc.pth; do
+                printf '%s\t%s\n' "/build/lib/${file}" "${lib_dir}/${file}"
+            done
+        done
+
+        printf '%s\t%s\t0755\n' "${UMU_DIR}/builddir/umu-run" "${app}/bin/umu-run"
+        printf '%s\t%s\n' "${_VERSION_FILE}" "${app}/umu_version.json"
+    } > "${manifest}"
+
+    if [[ -n "${PAYLOAD_TUNE:-}" ]]; then
+        _message "Building extraction benchmark..."
+        make -C "${WORK_DIR}/wrapper" -f /build/lib/Makefile bench/extract_bench ||
+            _failure "Failed to compile extraction benchmark"
+
+        _message "Tuning payload compression (weight ${PAYLOAD_TUNE})..."
+        if ! python3 "${WORK_DIR}/wrapper/tools/tune_payload.py" \
+                --pack "${WORK_DIR}/wrapper/tools/pack" \
+                --bench "${WORK_DIR}/wrapper/bench/extract_bench" \
+                -m "${manifest}" -o "${WORK_DIR}/archive.tar.zst" \
+                --weight "${PAYLOAD_TUNE}" \
+                --report "${BUILD_DIR}/payload-tune.json" \
+                --contents "${PAYLOAD_CONTENTS}"; then
+            rm -f "${manifest}" "${WORK_DIR}/archive.tar.zst"
+            _failure "Payload tuning failed"
+        fi
+    else
+        _message "Creating archive..."
+        if ! "${WORK_DIR}/wrapper/tools/pack" -m "${manifest}" \
+                -o "${WORK_DIR}/archive.tar.zst" -l 22 -T 0 \
+                -r "${PAYLOAD_CONTENTS}"; then
+            rm -f "${manifest}" "${WORK_DIR}/archive.tar.zst"
+            _failure "Archive creation failed"
+        fi
+    fi
+    rm -f "${manifest}"
+
+    report_payload
+}
+
+# What the payload's bytes are spent on, in ${WORK_DIR}/payload-report.txt
+# and .json: pack's listing joined with the import trace build.sh recorded
+# and the bundled interpreter's startup import times
+report_payload() {
+    local importtime="${WORK_DIR}/payload-importtime.txt"
+    local pythonpath="${UMU_DIR}"
+    local report_args=()
+    local subproject
+
+    for subproject in "${UMU_DIR}"/subprojects/*/; do
+        [[ -d "${subproject}src" ]] && subproject="${subproject}src"
+        pythonpath+=":${subproject%/}"
+    done
+
+    _message "Measuring startup imports..."
+    if PYTHONPATH="${pythonpath}" "${PYTHON_DIR}/bin/python3" -X importtime \
+            -c 'import umu.umu_run' 2> "${importtime}"; then
+        report_args+=(--importtime "${importtime}")
+    else
+        _warning "Could not import umu.umu_run, reporting without import times"
+    fi
+    if [[ -f "${WORK_DIR}/import-trace.txt" ]]; then
+        report_args+=(--import-trace "${WORK_DIR}/import-trace.txt")
     fi
-done
 
-# Create compressed archive
-_message "Creating archive..."
-# Use a subshell to avoid changing the working directory in the main script
-if ! (cd "${STAGE_DIR}" && bsdtar --options zstd:compression-level=22,zstd:threads=0 \
-            --zstd -cf "${WORK_DIR}/archive.tar.zst" ./python ./apps); then
-    rm -rf "${STAGE_DIR}"
-    _failure "Archive creation failed"
-fi
-
-readonly ARCHIVE_SIZE=$(stat -c%s "${WORK_DIR}/archive.tar.zst")
-
-# Combine wrapper and archive
-_message "Assembling final executable..."
-if ! cat "${WORK_DIR}/umu-run" "${WORK_DIR}/archive.tar.zst" > "${BUILD_OUTPUT}"; then
-    rm -rf "${STAGE_DIR}"
-    rm -f "${WORK_DIR}/umu-run" "${WORK_DIR}/archive.tar.zst"
-    _failure "Failed to combine wrapper with archive"
-fi
-
-if ! printf "%020d" "${ARCHIVE_SIZE}" >> "${BUILD_OUTPUT}"; then
-    rm -rf "${STAGE_DIR}"
-    rm -f "${BUILD_OUTPUT}" "${WORK_DIR}/umu-run" "${WORK_DIR}/archive.tar.zst"
-    _failure "Failed to append archive size"
-fi
-
-chmod +x "${BUILD_OUTPUT}"
-
-# Cleanup
-rm -rf "${STAGE_DIR}"
-rm -f "${WORK_DIR}/umu-run" "${WORK_DIR}/archive.tar.zst"
+    python3 /build/lib/payload_report.py \
+        --contents "${PAYLOAD_CONTENTS}" \
+        --archive "${WORK_DIR}/archive.tar.zst" \
+        --json "${WORK_DIR}/payload-report.json" \
+        "${report_args[@]}" > "${WORK_DIR}/payload-report.txt" ||
+        _failure "Failed to write the payload report"
+    rm -f "${importtime}" "${PAYLOAD_CONTENTS}"
+}
+
+for stage in ${BUILD_STAGES}; do
+    case "${stage}" in
+        umu|wrapper|payload)
+            "build_${stage}"
+            ;;
+        *)
+            _failure "Unknown build stage: ${stage}"
+            ;;
+    esac
+done
 
 _message "Build completed successfully"
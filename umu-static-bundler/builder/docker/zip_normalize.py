@@ -0,0 +1,50 @@
+"""
+Rewrite a zip file, or a zipapp keeping its #! line, so that the same
+contents always give the same bytes: entries in name order, each stamped
+with SOURCE_DATE_EPOCH (zip dates start in 1980) and Unix attributes.
+
+Usage: zip_normalize.py <file>
+"""
+
+import io
+import os
+import sys
+import time
+import zipfile
+
+ZIP_EPOCH = 315532800  # 1980-01-01
+
+
+def main(argv):
+    if len(argv) != 2:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    path = argv[1]
+    epoch = int(os.environ.get("SOURCE_DATE_EPOCH", "0"))
+    date_time = time.gmtime(max(epoch, ZIP_EPOCH))[:6]
+
+    with open(path, "rb") as f:
+        data = f.read()
+    prefix = data[:data.index(b"\n") + 1] if data.startswith(b"#!") else b""
+
+    out = io.BytesIO()
+    out.write(prefix)
+    with zipfile.ZipFile(io.BytesIO(data)) as zin, \
+            zipfile.ZipFile(out, "w") as zout:
+        for info in sorted(zin.infolist(), key=lambda i: i.filename):
+            entry = zipfile.ZipInfo(info.filename, date_time)
+            entry.compress_type = info.compress_type
+            entry.create_system = 3
+            entry.external_attr = info.external_attr
+            zout.writestr(entry, zin.read(info))
+
+    tmp = path + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(out.getvalue())
+    os.chmod(tmp, os.stat(path).st_mode & 0o7777)
+    os.replace(tmp, path)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
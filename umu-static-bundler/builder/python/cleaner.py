@@ -6,12 +6,22 @@ See umu-cleaner-config.py for an example of specifying extra module-specific opt
 
 import argparse
 import ast
+import fnmatch
+import hashlib
+import json
 import logging
+import os
+import re
 import shutil
+import subprocess
 import sys
+import time
+from concurrent.futures import ProcessPoolExecutor
 from dataclasses import dataclass, field
 from pathlib import Path
-from typing import Dict, Set, Tuple
+from typing import Dict, List, Optional, Set, Tuple
+
+from import_trace import load as import_trace_load
 
 @dataclass
 class CleanerConfig:
@@ -49,6 +59,25 @@ class CleanerConfig:
         'LICENSE*', 'README*', 'CHANGES*', 'NEWS*',
     })
 
+    # Modules the import closure cannot see being imported (importlib,
+    # __import__, or imports made from C), always kept with their parents.
+    # Entries are module names or fnmatch patterns over module names.
+    dynamic_imports: Set[str] = field(default_factory=lambda: {
+        '_strptime',        # time.strptime
+        'traceback',        # Uncaught exception printing
+        'linecache',
+        'warnings',
+        '_sysconfigdata_*', # sysconfig
+        'sitecustomize', 'usercustomize',
+    })
+
+    # Modules an --import-trace run imports only to drive the tests; they are
+    # not checked against the cleaned distribution (fnmatch patterns)
+    trace_ignores: Set[str] = field(default_factory=lambda: {
+        'unittest', 'unittest.*',
+        'test', 'test.*',
+    })
+
     # Project-specific configurations
     optional_dependencies: Set[str] = field(default_factory=set)
     project_specific_ignores: Set[str] = field(default_factory=set)
@@ -76,27 +105,81 @@ class CleanerConfig:
         return config
 
 class ImportAnalyzer(ast.NodeVisitor):
-    """AST visitor that collects and categorizes import statements."""
+    """AST visitor that collects and categorizes import statements.
+
+    Besides the categorized top-level names (top_imports holds them before
+    categorization, for cached results), module_imports collects every
+    dotted name an import could load ('from a.b import c' yields a.b and
+    a.b.c), with relative imports resolved against package. Imports under
+    'if __name__ == "__main__"' and 'if TYPE_CHECKING' are skipped, since
+    they never run when the module is imported.
+    """
 
-    def __init__(self, config: CleanerConfig):
+    def __init__(self, config: CleanerConfig, package: str = ''):
         self.config = config
+        self.package = package
         self.runtime_imports: Set[str] = set()
         self.build_imports: Set[str] = set()
         self.optional_imports: Set[str] = set()
+        self.top_imports: Set[str] = set()
+        self.module_imports: Set[str] = set()
 
     def visit_Import(self, node: ast.Import) -> None:
         """Process 'import foo' statements."""
         for name in node.names:
-            base_module = name.name.split('.')[0]
-            if not self._should_ignore(base_module):
-                self._categorize_import(base_module)
+            self.module_imports.add(name.name)
+            self.categorize(name.name.split('.')[0])
 
     def visit_ImportFrom(self, node: ast.ImportFrom) -> None:
         """Process 'from foo import bar' statements."""
-        if node.module:
-            base_module = node.module.split('.')[0]
-            if not self._should_ignore(base_module):
-                self._categorize_import(base_module)
+        module = self._resolve(node.module, node.level)
+        if module:
+            self.module_imports.add(module)
+            for name in node.names:
+                if name.name != '*':
+                    self.module_imports.add(f"{module}.{name.name}")
+
+        if node.module and node.level == 0:
+            self.categorize(node.module.split('.')[0])
+
+    def categorize(self, module: str) -> None:
+        """Record a top-level module name unless it is ignored."""
+        self.top_imports.add(module)
+        if not self._should_ignore(module):
+            self._categorize_import(module)
+
+    def visit_If(self, node: ast.If) -> None:
+        """Skip blocks that never run on import."""
+        if self._is_main_guard(node.test) or self._is_type_checking(node.test):
+            for child in node.orelse:
+                self.visit(child)
+            return
+        self.generic_visit(node)
+
+    def _resolve(self, module: Optional[str], level: int) -> Optional[str]:
+        """Turn a possibly relative import into an absolute module name."""
+        if level == 0:
+            return module
+        parts = self.package.split('.') if self.package else []
+        if level - 1 > len(parts) or not self.package:
+            return None
+        base = '.'.join(parts[:len(parts) - (level - 1)])
+        return f"{base}.{module}" if module else base
+
+    @staticmethod
+    def _is_main_guard(test: ast.expr) -> bool:
+        return (isinstance(test, ast.Compare) and
+                isinstance(test.left, ast.Name) and
+                test.left.id == '__name__' and
+                len(test.comparators) == 1 and
+                isinstance(test.comparators[0], ast.Constant) and
+                test.comparators[0].value == '__main__')
+
+    @staticmethod
+    def _is_type_checking(test: ast.expr) -> bool:
+        return ((isinstance(test, ast.Name) and test.id == 'TYPE_CHECKING') or
+                (isinstance(test, ast.Attribute) and
+                 test.attr == 'TYPE_CHECKING'))
 
     def _should_ignore(self, module: str) -> bool:
         """Check if a module should be ignored during analysis."""
@@ -111,17 +194,100 @@ class ImportAnalyzer(ast.NodeVisitor):
         else:
             self.runtime_imports.add(module)
 
+# Bumped whenever the cached analysis results change shape
+ANALYSIS_CACHE_VERSION = 1
+
+# Metadata comment lines dropped from bundled sources by --strip-comments
+METADATA_COMMENT = re.compile(rb'^#[^\n]*(?:coding|Author|Copyright)[^\n]*\n?',
+                              re.MULTILINE)
+
+def scan_source(job: Tuple[str, str, bytes]):
+    """Parse one file (in a worker process).
+
+    Returns (top-level imports, module imports) as sorted lists, or the
+    error message if the file does not parse."""
+    filename, package, data = job
+    try:
+        tree = ast.parse(data, filename)
+    except (SyntaxError, ValueError) as e:
+        return str(e)
+    analyzer = ImportAnalyzer(CleanerConfig(), package)
+    analyzer.visit(tree)
+    return sorted(analyzer.top_imports), sorted(analyzer.module_imports)
+
+class AnalysisCache:
+    """scan_source results keyed by file content hash and package.
+
+    Stored as one JSON file per interpreter version, since ast.parse output
+    depends on it. Entries not used by a run are dropped when it saves."""
+
+    def __init__(self, cache_dir: Optional[Path]):
+        self.path = None
+        self.entries: Dict[str, list] = {}
+        self.used: Dict[str, list] = {}
+        if cache_dir:
+            version = f"{sys.version_info[0]}{sys.version_info[1]}"
+            self.path = cache_dir / f"imports-py{version}-v{ANALYSIS_CACHE_VERSION}.json"
+            try:
+                self.entries = json.loads(self.path.read_text())
+            except (OSError, ValueError):
+                self.entries = {}
+
+    def get(self, key: str) -> Optional[list]:
+        entry = self.used.get(key, self.entries.get(key))
+        if entry is not None:
+            self.used[key] = entry
+        return entry
+
+    def put(self, key: str, entry: list) -> None:
+        self.used[key] = entry
+
+    def save(self) -> None:
+        if not self.path or self.used == self.entries:
+            return
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        tmp = self.path.with_suffix('.tmp')
+        tmp.write_text(json.dumps(self.used, separators=(',', ':')))
+        tmp.replace(self.path)
+
 class PythonDistributionManager:
-    """Manages Python distribution analysis and cleaning."""
+    """Manages Python distribution analysis and cleaning.
+
+    The distribution is walked once; every later step works on that
+    listing, updated as files are removed, instead of going back to disk.
+    """
 
     def __init__(self, dist_path: Path, source_dir: Path, config: CleanerConfig,
-                 debug: bool = False):
+                 debug: bool = False, extra_sources: Optional[List[Path]] = None,
+                 prune_unreachable: bool = True,
+                 import_trace: Optional[Path] = None,
+                 jobs: Optional[int] = None, cache_dir: Optional[Path] = None,
+                 strip_comments: bool = False):
         self.dist_path = dist_path
         self.source_dir = source_dir
         self.config = config
         self.debug = debug
+        self.extra_sources = extra_sources or []
+        self.prune_unreachable = prune_unreachable
+        self.jobs = jobs or os.cpu_count() or 1
+        self.cache = AnalysisCache(cache_dir)
+        self.strip_comments = strip_comments
         self.logger = self._setup_logger()
 
+        # Modules seen imported at runtime; when set they replace the static
+        # closure as the set of modules to keep
+        self.traced: Optional[Set[str]] = None
+        if import_trace:
+            self.traced, _ = import_trace_load(import_trace)
+
+        # The walked distribution: surviving files with their sizes, and
+        # directories. Contents of files read for analysis are kept for
+        # --strip-comments so they are read only once.
+        self._files: Dict[Path, int] = {}
+        self._dirs: Set[Path] = set()
+        self._contents: Dict[Path, bytes] = {}
+        self._analysis: Dict[Path, Optional[list]] = {}
+
     def _setup_logger(self) -> logging.Logger:
         level = logging.DEBUG if self.debug else logging.INFO
         logging.basicConfig(level=level, format='%(message)s')
@@ -134,81 +300,340 @@ class PythonDistributionManager:
                 return path
         raise RuntimeError("Could not find Python library directory")
 
-    def analyze_imports(self) -> Tuple[Set[str], Dict[str, int]]:
-        """Analyze imports in the source directory."""
-        runtime_imports = set()
-        file_stats = {'total': 0, 'analyzed': 0, 'errors': 0}
+    def _walk(self) -> None:
+        """List the whole distribution in one pass."""
+        for root, dirnames, filenames in os.walk(self.dist_path):
+            base = Path(root)
+            self._dirs.update(base / name for name in dirnames)
+            for name in filenames:
+                path = base / name
+                try:
+                    self._files[path] = path.lstat().st_size
+                except OSError:
+                    pass
 
-        for path in self.source_dir.rglob('*.py'):
-            file_stats['total'] += 1
+    def _remove(self, path: Path) -> None:
+        """Delete a file or directory tree and drop it from the listing."""
+        if path in self._dirs:
+            shutil.rmtree(path, ignore_errors=True)
+            prefix = f"{path}{os.sep}"
+            self._dirs = {d for d in self._dirs
+                          if d != path and not str(d).startswith(prefix)}
+            for gone in [f for f in self._files if str(f).startswith(prefix)]:
+                del self._files[gone]
+        else:
+            path.unlink(missing_ok=True)
+            self._files.pop(path, None)
+
+    def _source_files(self):
+        yield from self.source_dir.rglob('*.py')
+        yield from self._extra_source_files()
+
+    def _extra_source_files(self):
+        for extra in self.extra_sources:
+            yield from (extra.rglob('*.py') if extra.is_dir() else [extra])
+
+    def _analyze_files(self, files: List[Tuple[Path, str]]) -> Dict[Path, Optional[list]]:
+        """scan_source results for (path, package) pairs.
+
+        Cached results are looked up by content hash; the rest are parsed
+        on a process pool. Files that fail to parse map to None."""
+        results: Dict[Path, Optional[list]] = {}
+        jobs = []
+        for path, package in files:
             try:
-                with open(path) as f:
-                    tree = ast.parse(f.read(), str(path))
-                analyzer = ImportAnalyzer(self.config)
-                analyzer.visit(tree)
-                runtime_imports.update(analyzer.runtime_imports)
-                file_stats['analyzed'] += 1
-            except (SyntaxError, FileNotFoundError) as e:
+                data = path.read_bytes()
+            except OSError as e:
                 self.logger.warning(f"Warning: analyzing {path} raised {e}")
-                file_stats['errors'] += 1
+                results[path] = None
+                continue
+            if self.strip_comments and path in self._files:
+                self._contents[path] = data
+            key = f"{hashlib.sha256(data).hexdigest()}:{package}"
+            entry = self.cache.get(key)
+            if entry is not None:
+                results[path] = entry
+            else:
+                jobs.append((path, key, (str(path), package, data)))
+
+        start = time.monotonic()
+        if self.jobs > 1 and len(jobs) > 1:
+            with ProcessPoolExecutor(min(self.jobs, len(jobs))) as pool:
+                scanned = list(pool.map(scan_source, [job for _, _, job in jobs],
+                                        chunksize=16))
+        else:
+            scanned = [scan_source(job) for _, _, job in jobs]
 
+        for (path, key, _), result in zip(jobs, scanned):
+            if isinstance(result, str):
+                self.logger.warning(f"Warning: analyzing {path} raised {result}")
+                results[path] = None
+            else:
+                self.cache.put(key, list(result))
+                results[path] = list(result)
+
+        self.logger.debug(f"Analyzed {len(files)} files: {len(files) - len(jobs)} "
+                          f"cached, {len(jobs)} parsed in "
+                          f"{time.monotonic() - start:.2f}s with {self.jobs} jobs")
+        return results
+
+    def analyze_imports(self) -> Tuple[Set[str], Dict[str, int]]:
+        """Analyze imports in the source directory."""
+        runtime_imports, _, file_stats = self._analyze_sources()
         return runtime_imports, file_stats
 
+    def _analyze_sources(self) -> Tuple[Set[str], Set[str], Dict[str, int]]:
+        """Top-level runtime imports and full module names the sources use."""
+        paths = list(self._source_files())
+        results = self._analyze_files([(path, '') for path in paths])
+        file_stats = {'total': len(paths), 'analyzed': 0, 'errors': 0}
+
+        analyzer = ImportAnalyzer(self.config)
+        module_imports = set()
+        for result in results.values():
+            if result is None:
+                file_stats['errors'] += 1
+                continue
+            top_imports, modules = result
+            for module in top_imports:
+                analyzer.categorize(module)
+            module_imports.update(modules)
+            file_stats['analyzed'] += 1
+
+        runtime_imports = analyzer.runtime_imports | analyzer.optional_imports
+        module_imports = {name for name in module_imports
+                          if name.split('.')[0] in runtime_imports}
+        return runtime_imports, module_imports, file_stats
+
+    def _index_modules(self, python_lib: Path) -> Dict[str, List[Path]]:
+        """Map every module name in the stdlib to the files providing it."""
+        index: Dict[str, List[Path]] = {}
+        dynload = python_lib / 'lib-dynload'
+        for path in self._files:
+            if path.parent == dynload and path.suffix == '.so':
+                # Extension modules are top-level: _ssl.cpython-313-x86_64-linux-gnu.so
+                index.setdefault(path.name.split('.')[0], []).append(path)
+                continue
+            if path.suffix != '.py' or python_lib not in path.parents:
+                continue
+            parts = list(path.relative_to(python_lib).with_suffix('').parts)
+            if parts[0] in ('site-packages', 'lib-dynload'):
+                continue
+            if parts[-1] == '__init__':
+                parts.pop()
+            if parts and all(part.isidentifier() for part in parts):
+                index.setdefault('.'.join(parts), []).append(path)
+        return index
+
+    def _startup_modules(self) -> Set[str]:
+        """Modules the interpreter imports before running any script."""
+        for python in (self.dist_path / 'bin' / 'python3', Path(sys.executable)):
+            try:
+                result = subprocess.run(
+                    [str(python), '-I', '-B', '-c',
+                     'import sys; print("\\n".join(sys.modules))'],
+                    capture_output=True, text=True, timeout=60, check=True)
+                return set(result.stdout.split())
+            except (OSError, subprocess.SubprocessError):
+                continue
+        self.logger.warning("Warning: could not list interpreter startup modules")
+        return {'site', 'os', 'codecs', 'io', 'abc', 'stat', 'posixpath',
+                'genericpath', '_collections_abc', '_sitebuiltins'}
+
+    def _module_deps(self, name: str, path: Path,
+                     index: Dict[str, List[Path]]) -> Set[str]:
+        """Modules a single stdlib file can import."""
+        if path.suffix == '.so':
+            # Extensions import through the C API by name; look for known
+            # module names among the binary's strings
+            data = path.read_bytes()
+            return {token.decode() for token in
+                    re.findall(rb'[A-Za-z_][A-Za-z0-9_.]{1,63}', data)
+                    if token.decode() in index}
+
+        result = self._analysis.get(path)
+        return set(result[1]) if result else set()
+
+    @staticmethod
+    def _package_of(name: str, path: Path) -> str:
+        return name if path.name == '__init__.py' else name.rpartition('.')[0]
+
+    def compute_import_closure(self, python_lib: Path,
+                               index: Dict[str, List[Path]]) -> Set[str]:
+        """All stdlib modules reachable from the application's imports.
+
+        The application's and extra sources' imports are always followed,
+        so modules they import lazily stay. An import trace adds the traced
+        modules as further roots and narrows the rest: the startup modules
+        and allowlists are then kept with their parent packages, but their
+        own imports are not followed, since the traced runs show which of
+        those are used."""
+        pinned = self._startup_modules()
+        for name in index:
+            top = name.split('.')[0]
+            if (top in self.config.essential_dirs or
+                    any(fnmatch.fnmatchcase(name, pattern)
+                        for pattern in self.config.dynamic_imports)):
+                pinned.add(name)
+
+        _, roots, _ = self._analyze_sources()
+        if self.traced is not None:
+            roots |= self.traced
+        else:
+            roots |= pinned
+            pinned = set()
+
+        # Parse every stdlib source up front so the pool sees all of them
+        self._analysis = self._analyze_files(
+            [(path, self._package_of(name, path))
+             for name, paths in index.items()
+             for path in paths if path.suffix == '.py'])
+
+        reachable: Set[str] = set()
+        queue = list(roots)
+        while queue:
+            name = queue.pop()
+            if name in reachable or name not in index:
+                continue
+            reachable.add(name)
+
+            # Importing a.b.c runs a and a.b first
+            parts = name.split('.')
+            queue.extend('.'.join(parts[:i]) for i in range(1, len(parts)))
+            for path in index[name]:
+                queue.extend(self._module_deps(name, path, index))
+
+        for name in pinned:
+            parts = name.split('.')
+            reachable.update(parent for parent in
+                             ('.'.join(parts[:i]) for i in range(1, len(parts) + 1))
+                             if parent in index)
+
+        return reachable
+
+    def prune_import_closure(self, python_lib: Path) -> Tuple[int, int]:
+        """Delete stdlib modules the application can never import.
+
+        Returns (modules reachable, modules removed)."""
+        index = self._index_modules(python_lib)
+        reachable = self.compute_import_closure(python_lib, index)
+        removed = 0
+
+        # Outermost first, so a whole unreachable package goes in one rmtree
+        for name in sorted(index, key=lambda n: n.count('.')):
+            if name in reachable:
+                continue
+            for path in index[name]:
+                if path not in self._files:
+                    continue  # Inside a package already removed
+                self._remove(path.parent if path.name == '__init__.py' else path)
+                removed += 1
+                self.logger.debug(f"Unreachable: {name} ({path})")
+
+        return len(reachable), removed
+
+    def verify_trace(self, index: Dict[str, List[Path]]) -> List[str]:
+        """Traced modules that were in the distribution but are gone now."""
+        missing = []
+        for name in sorted(self.traced & index.keys()):
+            if any(fnmatch.fnmatchcase(name, pattern)
+                   for pattern in self.config.trace_ignores):
+                continue
+            if not any(path in self._files for path in index[name]):
+                missing.append(name)
+        return missing
+
+    def _is_essential(self, path: Path) -> bool:
+        return any(part in self.config.essential_dirs
+                   for part in path.relative_to(self.dist_path).parts[:-1])
+
+    def _is_removable(self, path: Path) -> bool:
+        if path in self._dirs:
+            return any(path.match(pattern) for pattern in self.config.removable_dirs)
+        return (path.name in self.config.removable_modules or
+                any(path.match(pattern) for pattern in self.config.removable_files))
+
+    def _strip_metadata_comments(self) -> int:
+        """Drop metadata comment lines from the remaining sources."""
+        stripped = 0
+        for path in [path for path in self._files if path.suffix == '.py']:
+            data = self._contents.pop(path, None)
+            if data is None:
+                try:
+                    data = path.read_bytes()
+                except OSError:
+                    continue
+            new_data = METADATA_COMMENT.sub(b'', data)
+            if new_data != data:
+                path.write_bytes(new_data)
+                self._files[path] = len(new_data)
+                stripped += 1
+        return stripped
+
     def clean_distribution(self) -> Dict[str, int]:
         """Clean the Python distribution while preserving required modules."""
         stats = {'removed': 0, 'initial_size': 0, 'final_size': 0}
 
-        stats['initial_size'] = sum(f.stat().st_size for f in self.dist_path.rglob('*') if f.is_file())
+        self._walk()
+        stats['initial_size'] = sum(self._files.values())
+
+        python_lib = self._get_lib_path()
+        original_index = (self._index_modules(python_lib)
+                          if self.traced is not None else {})
 
         # Get required modules
         required_modules, analysis_stats = self.analyze_imports()
         self.logger.debug(f"Found {len(required_modules)} required modules")
         self.logger.debug(f"Analysis stats: {analysis_stats}")
 
-        # First clean Python-specific directories
-        python_lib = self._get_lib_path()
-        for path in python_lib.rglob('*'):
-            if any(parent.name in self.config.essential_dirs for parent in path.parents):
+        # First clean Python-specific directories. Parents sort before their
+        # children, so a removed directory's contents are skipped.
+        lib_entries = sorted(path for path in self._dirs | self._files.keys()
+                             if python_lib in path.parents)
+        for path in lib_entries:
+            if path not in self._dirs and path not in self._files:
+                continue  # Under a directory removed above
+            if self._is_essential(path):
                 continue
-
-            if path.is_file():
-                if (path.name in self.config.removable_modules or
-                    any(path.match(pattern) for pattern in self.config.removable_files)):
-                    path.unlink()
-                    stats['removed'] += 1
-
-            elif path.is_dir():
-                if any(path.match(pattern) for pattern in self.config.removable_dirs):
-                    shutil.rmtree(path, ignore_errors=True)
-                    stats['removed'] += 1
+            if self._is_removable(path):
+                self._remove(path)
+                stats['removed'] += 1
 
         # Then clean the main lib directory for Tcl/Tk and other non-Python files
         lib_dir = self.dist_path / 'lib'
-        if lib_dir.exists():
-            for path in lib_dir.iterdir():
-                # Skip the Python directory as we already cleaned it
-                if path == python_lib:
-                    continue
+        for path in sorted(path for path in self._dirs | self._files.keys()
+                           if path.parent == lib_dir and path != python_lib):
+            if self._is_removable(path):
+                self._remove(path)
+                stats['removed'] += 1
+
+        # Then drop stdlib modules outside the application's import closure
+        if self.prune_unreachable:
+            reachable, removed = self.prune_import_closure(python_lib)
+            self.logger.info(f"Import closure: {reachable} modules reachable, "
+                             f"{removed} unreachable removed")
+            stats['removed'] += removed
+        self.cache.save()
+
+        if self.strip_comments:
+            stripped = self._strip_metadata_comments()
+            self.logger.debug(f"Stripped metadata comments from {stripped} files")
+
+        # Clean empty directories, deepest first
+        occupied = {parent for path in self._files for parent in path.parents}
+        for path in sorted(self._dirs - occupied, reverse=True):
+            try:
+                path.rmdir()
+                stats['removed'] += 1
+            except OSError:
+                pass
 
-                if path.is_dir():
-                    if any(path.match(pattern) for pattern in self.config.removable_dirs):
-                        shutil.rmtree(path)
-                        stats['removed'] += 1
-                elif path.is_file():
-                    if any(path.match(pattern) for pattern in self.config.removable_files):
-                        path.unlink()
-                        stats['removed'] += 1
-
-        # Clean empty directories
-        for path in sorted(self.dist_path.rglob('*'), reverse=True):
-            if path.is_dir() and not any(path.iterdir()):
-                try:
-                    path.rmdir()
-                    stats['removed'] += 1
-                except OSError:
-                    pass
+        stats['final_size'] = sum(self._files.values())
 
-        stats['final_size'] = sum(f.stat().st_size for f in self.dist_path.rglob('*') if f.is_file())
+        # Something the application imported at runtime was removed, by a
+        # removable_* pattern or by the pruning above
+        if self.traced is not None:
+            stats['missing'] = self.verify_trace(original_index)
 
         return stats
 
@@ -228,6 +653,20 @@ def main():
                       help='Enable debug logging')
     parser.add_argument('--project-ignores', type=str, nargs='*',
                       help='Additional project-specific modules to ignore')
+    parser.add_argument('--extra-source', type=Path, action='append', default=[],
+                      help='Additional file or directory whose imports must be kept')
+    parser.add_argument('--no-prune-unreachable', action='store_true',
+                      help='Keep stdlib modules outside the import closure')
+    parser.add_argument('--jobs', type=int,
+                      help='Worker processes for import analysis (default: CPU count)')
+    parser.add_argument('--cache-dir', type=Path,
+                      help='Directory to cache import analysis results in')
+    parser.add_argument('--strip-comments', action='store_true',
+                      help='Drop coding/Author/Copyright comment lines from sources')
+    parser.add_argument('--import-trace', type=Path,
+                      help='Also keep the modules in this import_trace.py trace '
+                           'instead of following the allowlists\' imports, and '
+                           'fail if a traced module is removed')
 
     args = parser.parse_args()
 
@@ -243,7 +682,12 @@ def main():
     if args.project_ignores:
         config.project_specific_ignores.update(args.project_ignores)
 
-    manager = PythonDistributionManager(args.dist_path, args.source_dir, config, args.debug)
+    manager = PythonDistributionManager(args.dist_path, args.source_dir, config, args.debug,
+                                        extra_sources=args.extra_source,
+                                        prune_unreachable=not args.no_prune_unreachable,
+                                        import_trace=args.import_trace,
+                                        jobs=args.jobs, cache_dir=args.cache_dir,
+                                        strip_comments=args.strip_comments)
 
     if args.imports_only:
         imports, stats = manager.analyze_imports()
@@ -259,5 +703,11 @@ def main():
     manager.logger.info(f"Space saved: {size_saved:.1f}MB")
     manager.logger.info(f"Final distribution size: {final_size:.1f}MB")
 
+    if stats.get('missing'):
+        manager.logger.error("Removed modules that were imported at runtime "
+                             f"(see {args.import_trace}): "
+                             f"{', '.join(stats['missing'])}")
+        sys.exit(1)
+
 if __name__ == '__main__':
     main()
@@ -0,0 +1,152 @@
+"""
+Record which stdlib modules and files an application touches at runtime.
+
+Static import analysis cannot see importlib.import_module(), __import__()
+or imports made from C, so the cleaner pads essential_dirs by hand. This
+runs commands (the umu-launcher test suite, a scripted launch) under an
+audit hook that logs every 'import' and 'open' event, plus whatever is in
+sys.modules at exit, in every Python process they start, and merges the
+result into one trace:
+
+    import <module>
+    open <path under the interpreter prefix>
+
+The cleaner reads the trace with --import-trace: it keeps what was touched
+on top of the static import closure, and fails if something traced was
+removed anyway. The trace is left in place for later stages to reuse.
+
+    python3 import_trace.py record -o import-trace.txt -- \
+        python3 -m unittest ';;' python3 app.py --help
+"""
+
+import atexit
+import os
+import sys
+
+
+def install(trace_dir):
+    """Log this process's imports and opens to <trace_dir>/<pid>.txt."""
+    imports = set()
+    opens = set()
+    prefix = os.path.realpath(sys.base_prefix) + os.sep
+    recording = True
+
+    def hook(event, args):
+        if not recording:
+            return
+        if event == "import":
+            imports.add(args[0])
+        elif event == "open" and isinstance(args[0], str):
+            path = os.path.realpath(args[0])
+            if path.startswith(prefix):
+                opens.add(path[len(prefix):])
+
+    def dump():
+        nonlocal recording
+        recording = False
+        # importlib.import_module() does not raise the 'import' event
+        imports.update(sys.modules)
+        path = os.path.join(trace_dir, f"{os.getpid()}.txt")
+        with open(path, "a") as f:
+            f.writelines(f"import {name}\n" for name in imports)
+            f.writelines(f"open {name}\n" for name in opens)
+
+    atexit.register(dump)
+    sys.addaudithook(hook)
+
+
+def load(path):
+    """Read a merged trace into (imported modules, opened paths)."""
+    imports, opens = set(), set()
+    with open(path) as f:
+        for line in f:
+            kind, _, value = line.rstrip("\n").partition(" ")
+            if kind == "import":
+                imports.add(value)
+            elif kind == "open":
+                opens.add(value)
+    return imports, opens
+
+
+def record(output, commands):
+    """Run each command with the hook installed; merge the per-pid logs."""
+    import shutil
+    import subprocess
+    import tempfile
+
+    work = tempfile.mkdtemp(prefix="import-trace-")
+    try:
+        trace_dir = os.path.join(work, "trace")
+        shim_dir = os.path.join(work, "shim")
+        os.mkdir(trace_dir)
+        os.mkdir(shim_dir)
+
+        # site imports sitecustomize from sys.path, which PYTHONPATH heads
+        here = os.path.dirname(os.path.abspath(__file__))
+        with open(os.path.join(shim_dir, "sitecustomize.py"), "w") as f:
+            f.write(f"import sys\nsys.path.insert(0, {here!r})\n"
+                    "import import_trace\nsys.path.pop(0)\n"
+                    f"import_trace.install({trace_dir!r})\n")
+
+        env = dict(os.environ)
+        env["PYTHONPATH"] = os.pathsep.join(
+            filter(None, [shim_dir, env.get("PYTHONPATH")]))
+
+        failed = 0
+        for command in commands:
+            print(f"import_trace: running {' '.join(command)}",
+                  file=sys.stderr)
+            status = subprocess.run(command, env=env).returncode
+            if status != 0:
+                print(f"import_trace: exited with {status}", file=sys.stderr)
+                failed += 1
+
+        lines = set()
+        for name in os.listdir(trace_dir):
+            with open(os.path.join(trace_dir, name)) as f:
+                lines.update(f)
+        if not lines:
+            print("import_trace: no Python process was traced",
+                  file=sys.stderr)
+            return 1
+
+        with open(output, "w") as f:
+            f.writelines(sorted(lines))
+        imports, opens = load(output)
+        print(f"import_trace: {len(imports)} imports, {len(opens)} files "
+              f"from {len(os.listdir(trace_dir))} processes, "
+              f"{failed} command(s) failed", file=sys.stderr)
+        return 0
+    finally:
+        shutil.rmtree(work, ignore_errors=True)
+
+
+def main(argv=None):
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Record runtime imports for the distribution cleaner")
+    sub = parser.add_subparsers(dest="action", required=True)
+    rec = sub.add_parser("record", help="run commands under the import hook")
+    rec.add_argument("-o", "--output", required=True,
+                     help="merged trace file to write")
+    rec.add_argument("commands", nargs="+",
+                     help="commands to run, separated by ';;'")
+    args = parser.parse_args(argv)
+
+    # "a b ;; c d" -> [[a, b], [c, d]]
+    commands = [[]]
+    for word in args.commands:
+        if word == ";;":
+            commands.append([])
+        else:
+            commands[-1].append(word)
+    commands = [command for command in commands if command]
+
+    # Failing test cases still produce a useful trace, so only a run that
+    # traced nothing at all is an error
+    return record(args.output, commands)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,236 @@
+"""
+Workloads for comparing bundled interpreters, and for PGO training.
+
+build.sh python-from-source builds CPython with mimalloc, PGO and LTO. This
+script both trains that build (--train, run as the PGO profile task) and
+compares the result against the prebuilt interpreter:
+
+    python3 interp_bench.py --umu work/umu-launcher \\
+        --python third_party/cache/cleanup_python3.13.2/bin/python3 \\
+        --python work/python/bin/python3,PYTHONMALLOC=mimalloc
+
+Each --python is an interpreter path, optionally followed by comma
+separated VAR=VALUE settings to run it with.
+
+Measured per interpreter:
+  - startup: 'python -c pass' and importing umu.umu_run, in fresh processes
+  - steady:  in-process work shaped like umu's: hashing files on a
+             ThreadPoolExecutor, tar packing and extraction, JSON round trips
+             and many small allocations
+
+Only the standard library is used, so any Python 3 can drive it.
+"""
+
+import argparse
+import hashlib
+import io
+import json
+import os
+import statistics
+import subprocess
+import sys
+import tarfile
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+
+def umu_path(umu_dir):
+    """sys.path entries for umu-launcher and its vendored dependencies."""
+    paths = [umu_dir]
+    subprojects = os.path.join(umu_dir, "subprojects")
+    if os.path.isdir(subprojects):
+        for name in sorted(os.listdir(subprojects)):
+            path = os.path.join(subprojects, name)
+            src = os.path.join(path, "src")
+            paths.append(src if os.path.isdir(src) else path)
+    return paths
+
+
+def make_tree(root, files=200, size=64 * 1024):
+    """A directory of pseudo-random files, like an unpacked runtime."""
+    for i in range(files):
+        sub = os.path.join(root, f"d{i % 16}")
+        os.makedirs(sub, exist_ok=True)
+        with open(os.path.join(sub, f"f{i}.bin"), "wb") as f:
+            f.write(hashlib.sha256(str(i).encode()).digest() * (size // 32))
+
+
+def work_hash(root):
+    paths = [os.path.join(d, name) for d, _, names in os.walk(root)
+             for name in names]
+
+    def digest(path):
+        h = hashlib.sha256()
+        with open(path, "rb") as f:
+            for chunk in iter(lambda: f.read(1 << 16), b""):
+                h.update(chunk)
+        return h.hexdigest()
+
+    with ThreadPoolExecutor(max_workers=os.cpu_count()) as pool:
+        return len(list(pool.map(digest, paths)))
+
+
+def work_tar(root, scratch):
+    buf = io.BytesIO()
+    with tarfile.open(fileobj=buf, mode="w:gz", compresslevel=1) as tar:
+        tar.add(root, arcname="tree")
+    buf.seek(0)
+    with tarfile.open(fileobj=buf, mode="r:gz") as tar:
+        if hasattr(tarfile, "data_filter"):
+            tar.extraction_filter = tarfile.data_filter
+        tar.extractall(scratch)
+    return buf.tell()
+
+
+def work_json():
+    doc = {"entries": [{"name": f"entry{i}", "size": i * 17,
+                        "tags": ["a", "b", str(i)], "nested": {"v": i / 3}}
+                       for i in range(20000)]}
+    for _ in range(5):
+        doc = json.loads(json.dumps(doc))
+    return len(doc["entries"])
+
+
+def work_alloc():
+    # Many short-lived mid-sized objects: the pattern that falls through
+    # pymalloc to the system allocator
+    total = 0
+    for i in range(200000):
+        total += len(bytearray(600 + i % 1000))
+        total += len([i] * (100 + i % 50))
+    return total
+
+
+WORKLOADS = {
+    "hash": lambda root, scratch: work_hash(root),
+    "tar": work_tar,
+    "json": lambda root, scratch: work_json(),
+    "alloc": lambda root, scratch: work_alloc(),
+}
+
+
+def run_workloads(repeat):
+    """Time each workload in this process; returns {name: [seconds]}."""
+    times = {name: [] for name in WORKLOADS}
+    with tempfile.TemporaryDirectory() as tmp:
+        root = os.path.join(tmp, "tree")
+        make_tree(root)
+        for i in range(repeat):
+            for name, fn in WORKLOADS.items():
+                scratch = os.path.join(tmp, f"x{name}{i}")
+                start = time.perf_counter()
+                fn(root, scratch)
+                times[name].append(time.perf_counter() - start)
+    return times
+
+
+def train(umu_dir):
+    """PGO profile task: umu's tests, a scripted launch and the workloads."""
+    import runpy
+    import unittest
+
+    if umu_dir:
+        sys.path[:0] = umu_path(umu_dir)
+        os.chdir(umu_dir)
+        suite = unittest.defaultTestLoader.discover("umu", "umu_test*.py",
+                                                    top_level_dir=".")
+        unittest.TextTestRunner(stream=io.StringIO()).run(suite)
+
+        argv = sys.argv
+        sys.argv = ["umu-run", "--help"]
+        try:
+            runpy.run_module("umu", run_name="__main__")
+        except SystemExit:
+            pass
+        finally:
+            sys.argv = argv
+
+    run_workloads(repeat=2)
+
+
+def time_process(python, args, env, runs):
+    times = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run([python, *args], env=env, check=True,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        times.append(time.perf_counter() - start)
+    return times
+
+
+def measure(spec, umu_dir, runs, repeat):
+    python, *settings = spec.split(",")
+    env = dict(os.environ)
+    env.pop("PYTHONPATH", None)
+    env.update(setting.split("=", 1) for setting in settings)
+    results = {"startup (-c pass)": time_process(
+        python, ["-c", "pass"], env, runs)}
+    if umu_dir:
+        env["PYTHONPATH"] = os.pathsep.join(umu_path(umu_dir))
+        try:
+            results["startup (import umu_run)"] = time_process(
+                python, ["-c", "import umu.umu_run"], env, runs)
+        except subprocess.CalledProcessError:
+            print(f"{python}: importing umu.umu_run failed", file=sys.stderr)
+        env.pop("PYTHONPATH")
+
+    # Steady state runs inside the interpreter under test
+    out = subprocess.run([python, os.path.abspath(__file__), "--worker",
+                          "--repeat", str(repeat)],
+                         env=env, check=True, capture_output=True, text=True)
+    for name, times in json.loads(out.stdout).items():
+        results[f"steady ({name})"] = times
+    return results
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description="Compare interpreters on startup and umu-like work")
+    parser.add_argument("--python", action="append", default=[],
+                        help="interpreter to measure (repeatable)")
+    parser.add_argument("--umu", help="umu-launcher source directory")
+    parser.add_argument("-n", "--runs", type=int, default=20,
+                        help="processes per startup measurement (default 20)")
+    parser.add_argument("--repeat", type=int, default=5,
+                        help="iterations per steady-state workload (default 5)")
+    parser.add_argument("-o", "--output", help="also write results as JSON")
+    parser.add_argument("--train", action="store_true",
+                        help="run the PGO training workload in this process")
+    parser.add_argument("--worker", action="store_true",
+                        help=argparse.SUPPRESS)
+    args = parser.parse_args(argv)
+
+    if args.worker:
+        json.dump(run_workloads(args.repeat), sys.stdout)
+        return 0
+    if args.train:
+        train(args.umu)
+        return 0
+    if not args.python:
+        parser.error("at least one --python is required")
+
+    results = {python: measure(python, args.umu, args.runs, args.repeat)
+               for python in args.python}
+
+    for i, python in enumerate(args.python, 1):
+        print(f"  #{i}: {python}")
+    print(f"\n  {'median':<26} " +
+          " ".join(f"{'#' + str(i):>16}" for i in range(1, len(args.python) + 1)) +
+          "  last/#1")
+    for name in results[args.python[0]]:
+        medians = [statistics.median(results[p][name]) * 1000
+                   if name in results[p] else float("nan")
+                   for p in args.python]
+        ratio = medians[-1] / medians[0] if medians[0] else float("nan")
+        print(f"  {name:<26} " + " ".join(f"{m:13.2f} ms" for m in medians) +
+              f"   {ratio:6.2f}x")
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(results, f, indent=1)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
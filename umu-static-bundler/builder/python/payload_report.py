@@ -0,0 +1,224 @@
+"""
+Break the compressed payload down by section, top-level module and file
+type, and say what each part is for.
+
+Reads the listing tools/pack writes with -r. The archive is one zstd
+stream, so what a file costs in it is estimated: pack compresses every file
+on its own as well, and those sizes are scaled to add up to the real
+archive. Each file is then attributed with the import trace
+(import_trace.py) and -X importtime reports (as PYB_PROFILE_IMPORTS
+leaves them, or python3 -X importtime's stderr):
+
+  startup   imported in an importtime report; its self time is counted
+  traced    imported or opened in the import trace, but not at startup
+  required  the interpreter and the apps themselves
+  unused    none of the above: dead weight, unless only used by code the
+            trace does not exercise
+
+Without a trace or importtime data every python file counts as unknown.
+
+    python3 payload_report.py --contents payload-contents.tsv \\
+        --archive archive.tar.zst --import-trace import-trace.txt \\
+        --importtime importtime.txt --json payload-report.json
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+from collections import defaultdict
+
+import pyb_importtime
+from import_trace import load as load_trace
+
+STATUSES = ("startup", "traced", "required", "unused", "unknown")
+_DYNLOAD = re.compile(r"^([^.]+)\..*so$")
+
+
+def load_contents(path):
+    """(archive path, kind, bytes, estimate) per entry."""
+    entries = []
+    with open(path) as f:
+        for line in f:
+            name, kind, size, estimate = line.rstrip("\n").split("\t")
+            entries.append((name, kind, int(size), int(estimate)))
+    return entries
+
+
+def load_importtime(paths):
+    """Mean self time in microseconds per module."""
+    reports = []
+    for path in paths:
+        with open(path, errors="replace") as f:
+            roots = pyb_importtime.parse_report(f)
+        if roots:
+            reports.append(roots)
+        else:
+            print(f"{path}: no import time lines", file=sys.stderr)
+    if not reports:
+        return {}
+    modules, _ = pyb_importtime.aggregate(reports)
+    return {name: self_us for name, (self_us, _, _) in modules.items()}
+
+
+def classify(name):
+    """(section, group, module or None, path under the python prefix)."""
+    parts = name.removeprefix("./").split("/")
+    section = parts[0]
+    if section != "python":
+        return section, "/".join(parts[:2]), None, None
+
+    rel = "/".join(parts[1:])
+    lib = parts[1:3]
+    if len(parts) < 4 or lib[0] != "lib" or not lib[1].startswith("python"):
+        return section, f"python/{parts[1]}", None, rel
+
+    rest = parts[3:]
+    if rest[0] == "site-packages" and len(rest) > 1:
+        rest = rest[1:]
+    if rest[0] == "lib-dynload" and len(rest) > 1:
+        match = _DYNLOAD.match(rest[1])
+        module = match.group(1) if match else None
+        return section, module or "lib-dynload", module, rel
+
+    if not rest[-1].endswith(".py"):
+        return section, rest[0], None, rel
+    module = [*rest[:-1], rest[-1][:-3]]
+    if module[-1] == "__init__":
+        module.pop()
+    module = ".".join(module)
+    return section, module.split(".", 1)[0] or rest[0], module, rel
+
+
+def file_type(name):
+    base = os.path.basename(name)
+    if ".so" in base:
+        return ".so"
+    return os.path.splitext(base)[1] or "(none)"
+
+
+def status_of(section, group, module, rel, trace, startup):
+    if section != "python" or group == "python/bin":
+        return "required"
+    if not trace and not startup:
+        return "unknown"
+    if module and module in startup:
+        return "startup"
+    imports, opens = trace or (set(), set())
+    if (module and module in imports) or (rel and rel in opens):
+        return "traced"
+    return "unused"
+
+
+def new_row():
+    return {"files": 0, "bytes": 0, "compressed": 0.0, "startup_us": 0.0,
+            **{f"{status}_compressed": 0.0 for status in STATUSES}}
+
+
+def build(entries, archive_bytes, trace, startup):
+    estimated = sum(estimate for *_, estimate in entries)
+    scale = archive_bytes / estimated if estimated else 0.0
+    sections = defaultdict(new_row)
+    groups = defaultdict(new_row)
+    types = defaultdict(new_row)
+    totals = new_row()
+    counted = set()
+
+    for name, kind, size, estimate in entries:
+        if kind != "f":
+            continue
+        section, group, module, rel = classify(name)
+        status = status_of(section, group, module, rel, trace, startup)
+        compressed = estimate * scale
+        for row in (sections[section], groups[group],
+                    types[file_type(name)], totals):
+            row["files"] += 1
+            row["bytes"] += size
+            row["compressed"] += compressed
+            row[f"{status}_compressed"] += compressed
+        if module in startup and module not in counted:
+            counted.add(module)
+            groups[group]["startup_us"] += startup[module]
+            sections[section]["startup_us"] += startup[module]
+            totals["startup_us"] += startup[module]
+
+    return {"archive_bytes": archive_bytes, "estimate_scale": scale,
+            "totals": totals, "sections": dict(sections),
+            "modules": dict(groups), "types": dict(types)}
+
+
+def print_table(title, rows, limit, out):
+    print(f"\n  {title:<28} {'files':>6} {'raw KB':>9} {'zstd KB':>9} "
+          f"{'startup':>8} {'unused':>8} {'import ms':>9}", file=out)
+    ranked = sorted(rows.items(), key=lambda item: -item[1]["compressed"])
+    for name, row in ranked[:limit]:
+        print(f"  {name[:28]:<28} {row['files']:6d} "
+              f"{row['bytes'] / 1024:9.1f} {row['compressed'] / 1024:9.1f} "
+              f"{row['startup_compressed'] / 1024:8.1f} "
+              f"{row['unused_compressed'] / 1024:8.1f} "
+              f"{row['startup_us'] / 1000:9.2f}", file=out)
+    if len(ranked) > limit:
+        rest = sum(row["compressed"] for _, row in ranked[limit:])
+        print(f"  ({len(ranked) - limit} more, {rest / 1024:.1f} KB)",
+              file=out)
+
+
+def print_report(report, limit, out=sys.stdout):
+    totals = report["totals"]
+    archive = report["archive_bytes"]
+    print(f"Payload: {totals['files']} files, {totals['bytes'] / 1e6:.1f} MB "
+          f"raw, {archive / 1e6:.2f} MB compressed "
+          f"({totals['bytes'] / archive if archive else 0:.2f}x)", file=out)
+    for status in STATUSES:
+        share = totals[f"{status}_compressed"]
+        if share:
+            print(f"  {status:<9} {share / 1024:10.1f} KB "
+                  f"{100 * share / archive:5.1f}%", file=out)
+    print("  (compressed sizes per file are estimates scaled to the "
+          "archive)", file=out)
+
+    print_table("section", report["sections"], limit, out)
+    print_table("top-level module", report["modules"], limit, out)
+    print_table("file type", report["types"], limit, out)
+
+    dead = {name: row for name, row in report["modules"].items()
+            if row["unused_compressed"] >= row["compressed"] > 0}
+    if dead:
+        total = sum(row["compressed"] for row in dead.values())
+        print(f"\nNever imported or opened ({total / 1024:.1f} KB): "
+              + ", ".join(sorted(dead, key=lambda n: -dead[n]["compressed"])
+                          [:limit]), file=out)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description="Attribute the payload's bytes to modules and startup")
+    parser.add_argument("--contents", required=True,
+                        help="listing written by pack -r")
+    parser.add_argument("--archive", required=True,
+                        help="the compressed payload")
+    parser.add_argument("--import-trace", help="import_trace.py output")
+    parser.add_argument("--importtime", action="append", default=[],
+                        help="-X importtime report (repeatable)")
+    parser.add_argument("-n", "--limit", type=int, default=25,
+                        help="rows per table (default 25)")
+    parser.add_argument("--json", help="also write the report as JSON")
+    args = parser.parse_args(argv)
+
+    trace = None
+    if args.import_trace and os.path.exists(args.import_trace):
+        trace = load_trace(args.import_trace)
+    report = build(load_contents(args.contents),
+                   os.path.getsize(args.archive), trace,
+                   load_importtime(args.importtime))
+    print_report(report, args.limit)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(report, f, indent=1)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,215 @@
+"""
+Aggregate -X importtime reports written by PYB_PROFILE_IMPORTS=1.
+
+Each launch with PYB_PROFILE_IMPORTS=1 leaves a report of its startup
+imports, up to the first other line on stderr, in
+<base_dir>/import-profiles/importtime-<pid>.txt. This reads one or more of
+them and prints:
+  - modules by mean cumulative import time
+  - top-level packages by mean self time, which maps onto the lists in
+    config.py (essential_dirs, removable_dirs, removable_modules)
+Optionally it also writes the mean import tree as folded stacks (for
+flamegraph.pl, speedscope or inferno) and/or as a self-contained SVG
+flame graph.
+
+Staged into site-packages alongside pyb_trace.py, so the bundled
+interpreter can run it:
+
+    python3 -m pyb_importtime ~/.local/share/pybstrap/import-profiles/*.txt \\
+        --svg imports.svg
+
+It only needs the standard library, so any Python 3 can run it as well,
+e.g. if the cleaner pruned argparse from the bundle.
+"""
+
+import argparse
+import html
+import re
+import sys
+from collections import defaultdict
+
+_LINE = re.compile(r"^import time:\s+(\d+)\s*\|\s*(\d+)\s*\|( *)(\S.*)$")
+
+
+class Node:
+    __slots__ = ("name", "self_us", "cum_us", "children")
+
+    def __init__(self, name, self_us=0, cum_us=0):
+        self.name = name
+        self.self_us = self_us
+        self.cum_us = cum_us
+        self.children = []
+
+
+def parse_report(lines):
+    """Build the import tree of one report. -X importtime prints a module
+    after everything it imported, one indent level deeper per nesting."""
+    entries = []
+    for line in lines:
+        match = _LINE.match(line.rstrip("\n"))
+        if match:
+            self_us, cum_us, indent, name = match.groups()
+            entries.append((len(indent), name.strip(), int(self_us),
+                            int(cum_us)))
+    if not entries:
+        return []
+
+    base = min(depth for depth, *_ in entries)
+    pending = defaultdict(list)
+    for depth, name, self_us, cum_us in entries:
+        node = Node(name, self_us, cum_us)
+        node.children = pending.pop(depth + 2, [])
+        pending[depth].append(node)
+    return pending[base]
+
+
+def walk(nodes, stack=()):
+    for node in nodes:
+        path = stack + (node.name,)
+        yield path, node
+        yield from walk(node.children, path)
+
+
+def aggregate(reports):
+    """Mean self/cumulative time per module and per import stack."""
+    modules = defaultdict(lambda: [0, 0, 0])  # self, cumulative, runs seen
+    stacks = defaultdict(int)
+    for roots in reports:
+        for path, node in walk(roots):
+            entry = modules[node.name]
+            entry[0] += node.self_us
+            entry[1] += node.cum_us
+            entry[2] += 1
+            stacks[path] += node.self_us
+    runs = len(reports)
+    modules = {name: (s / runs, c / runs, seen)
+               for name, (s, c, seen) in modules.items()}
+    stacks = {path: total / runs for path, total in stacks.items()}
+    return modules, stacks
+
+
+def print_tables(modules, runs, limit, out=sys.stdout):
+    total = sum(s for s, _, _ in modules.values())
+    print(f"{runs} report(s), {len(modules)} modules, "
+          f"{total / 1000:.1f} ms of import time per run\n", file=out)
+
+    print(f"  {'module':<40} {'self ms':>9} {'cum ms':>9} {'cum %':>6}",
+          file=out)
+    ranked = sorted(modules.items(), key=lambda item: -item[1][1])
+    for name, (self_us, cum_us, _) in ranked[:limit]:
+        share = 100 * cum_us / total if total else 0
+        print(f"  {name:<40} {self_us / 1000:9.2f} {cum_us / 1000:9.2f} "
+              f"{share:6.1f}", file=out)
+
+    packages = defaultdict(lambda: [0.0, 0])
+    for name, (self_us, _, _) in modules.items():
+        package = packages[name.split(".", 1)[0]]
+        package[0] += self_us
+        package[1] += 1
+    print(f"\n  {'top-level package':<40} {'self ms':>9} {'modules':>7} "
+          f"{'self %':>6}", file=out)
+    ranked = sorted(packages.items(), key=lambda item: -item[1][0])
+    for name, (self_us, count) in ranked[:limit]:
+        share = 100 * self_us / total if total else 0
+        print(f"  {name:<40} {self_us / 1000:9.2f} {count:7d} {share:6.1f}",
+              file=out)
+
+
+def write_folded(stacks, path):
+    with open(path, "w") as f:
+        for stack, self_us in sorted(stacks.items()):
+            if self_us >= 1:
+                f.write(f"{';'.join(stack)} {round(self_us)}\n")
+
+
+def write_svg(stacks, path, width=1200, row=16):
+    # Merge the folded stacks back into a tree of inclusive times
+    root = {"name": "all", "value": 0.0, "children": {}}
+    for stack, self_us in stacks.items():
+        node = root
+        node["value"] += self_us
+        for name in stack:
+            node = node["children"].setdefault(
+                name, {"name": name, "value": 0.0, "children": {}})
+            node["value"] += self_us
+
+    rects = []
+    depth_max = 0
+
+    def place(node, x, depth):
+        nonlocal depth_max
+        depth_max = max(depth_max, depth)
+        rects.append((x, depth, node))
+        child_x = x
+        for child in sorted(node["children"].values(),
+                            key=lambda n: n["name"]):
+            place(child, child_x, depth + 1)
+            child_x += child["value"]
+
+    place(root, 0.0, 0)
+    scale = width / root["value"] if root["value"] else 0
+    height = (depth_max + 1) * row + 40
+
+    out = [f'<svg xmlns="http://www.w3.org/2000/svg" width="{width}" '
+           f'height="{height}" font-family="monospace" font-size="11">',
+           f'<text x="4" y="16" font-size="14">Import time, '
+           f'{root["value"] / 1000:.1f} ms per run</text>']
+    for x, depth, node in rects:
+        w = node["value"] * scale
+        if w < 0.5:
+            continue
+        y = height - (depth + 1) * row - 4
+        hue = 20 + sum(map(ord, node["name"])) % 40
+        label = html.escape(node["name"])
+        title = f'{label} ({node["value"] / 1000:.2f} ms)'
+        out.append(f'<g><title>{title}</title>'
+                   f'<rect x="{x * scale:.1f}" y="{y}" width="{w:.1f}" '
+                   f'height="{row - 1}" fill="hsl({hue},90%,60%)"/>')
+        chars = int(w / 7)
+        if chars >= 3:
+            text = node["name"]
+            if len(text) > chars:
+                text = text[:chars - 2] + ".."
+            out.append(f'<text x="{x * scale + 3:.1f}" y="{y + row - 4}">'
+                       f'{html.escape(text)}</text>')
+        out.append("</g>")
+    out.append("</svg>")
+
+    with open(path, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        prog="pyb_importtime",
+        description="Summarise PYB_PROFILE_IMPORTS reports.")
+    parser.add_argument("reports", nargs="+",
+                        help="importtime-<pid>.txt files")
+    parser.add_argument("-n", "--limit", type=int, default=30,
+                        help="rows per table (default 30)")
+    parser.add_argument("--folded", help="write folded stacks to this file")
+    parser.add_argument("--svg", help="write an SVG flame graph to this file")
+    args = parser.parse_args(argv)
+
+    reports = []
+    for path in args.reports:
+        with open(path, errors="replace") as f:
+            roots = parse_report(f)
+        if roots:
+            reports.append(roots)
+        else:
+            print(f"{path}: no import time lines", file=sys.stderr)
+    if not reports:
+        return 1
+
+    modules, stacks = aggregate(reports)
+    print_tables(modules, len(reports), args.limit)
+    if args.folded:
+        write_folded(stacks, args.folded)
+    if args.svg:
+        write_svg(stacks, args.svg)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
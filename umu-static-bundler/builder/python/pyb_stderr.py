@@ -0,0 +1,49 @@
+"""
+Give a PYB_PROFILE_IMPORTS launch its stderr back once startup is over.
+
+With PYB_PROFILE_IMPORTS=1 the wrapper points the interpreter's stderr at
+a pipe into a filter that moves the -X importtime report to a file, and
+passes the real stderr down as the descriptor named by PYB_STDERR_FD.
+pyb_stderr.pth calls install() at interpreter startup. The first time the
+application starts another process, the startup imports have been
+reported, so the real stderr goes back onto fd 2. Wine and the game then
+write to it directly, and the filter exits once the interpreter no longer
+holds the pipe.
+"""
+
+import os
+import sys
+
+# Audit events raised when the interpreter starts another program
+_SPAWN_EVENTS = frozenset({"subprocess.Popen", "os.posix_spawn", "os.fork",
+                           "os.forkpty", "os.exec", "os.system"})
+_fd = -1
+
+
+def _restore():
+    global _fd
+    fd, _fd = _fd, -1
+    try:
+        sys.stderr.flush()
+    except (AttributeError, OSError, ValueError):
+        pass
+    os.dup2(fd, 2)
+    os.close(fd)
+
+
+def _hook(event, args):
+    if _fd >= 0 and event in _SPAWN_EVENTS:
+        _restore()
+
+
+def install():
+    """Restore the stderr in PYB_STDERR_FD before the first spawn."""
+    global _fd
+    try:
+        fd = int(os.environ.pop("PYB_STDERR_FD"))
+        # Only fd 2 should reach the programs started from here
+        os.set_inheritable(fd, False)
+    except (KeyError, ValueError, OSError):
+        return
+    _fd = fd
+    sys.addaudithook(_hook)
@@ -0,0 +1,103 @@
+"""
+Python-side counterpart of the wrapper's PYB_TRACE output.
+
+Appends Chrome trace events to the file named by PYB_TRACE, using the same
+line format, clock (CLOCK_MONOTONIC, microseconds) and pid as the wrapper so
+both halves of a launch land on one timeline. Does nothing when PYB_TRACE is
+unset. Staged into site-packages along with pyb_trace.pth, which imports it
+at interpreter startup when PYB_TRACE is set, to mark when site
+initialisation finished and when the interpreter exits.
+
+    import pyb_trace
+    with pyb_trace.span("load_config"):
+        ...
+"""
+
+import atexit
+import json
+import os
+import threading
+import time
+from contextlib import contextmanager
+
+_path = os.environ.get("PYB_TRACE")
+_lock = threading.Lock()
+_fd = -1
+
+
+def _open():
+    global _fd
+    if _fd >= 0 or not _path:
+        return _fd
+    try:
+        # Whoever creates the file writes the array opener; everyone else appends
+        _fd = os.open(_path, os.O_WRONLY | os.O_APPEND | os.O_CREAT | os.O_EXCL
+                      | os.O_CLOEXEC, 0o600)
+        os.write(_fd, b"[\n")
+    except FileExistsError:
+        try:
+            _fd = os.open(_path, os.O_WRONLY | os.O_APPEND | os.O_CLOEXEC)
+        except OSError:
+            _fd = -1
+    except OSError:
+        _fd = -1
+    return _fd
+
+
+def enabled():
+    """True if events are being written."""
+    return bool(_path)
+
+
+def _event(name, phase, args=None):
+    if not _path:
+        return
+    event = {
+        "name": name,
+        "cat": "python",
+        "ph": phase,
+        "ts": time.monotonic_ns() // 1000,
+        "pid": os.getpid(),
+        "tid": threading.get_native_id(),
+    }
+    if phase == "i":
+        event["s"] = "p"
+    if args:
+        event["args"] = args
+    line = (json.dumps(event, separators=(",", ":")) + ",\n").encode()
+    with _lock:
+        fd = _open()
+        if fd < 0:
+            return
+        try:
+            # One write per line keeps concurrent writers from interleaving
+            os.write(fd, line)
+        except OSError:
+            pass
+
+
+def begin(name):
+    _event(name, "B")
+
+
+def end(name, **args):
+    _event(name, "E", args)
+
+
+def instant(name, **args):
+    _event(name, "i", args)
+
+
+@contextmanager
+def span(name, **args):
+    """Record a begin/end pair around the block."""
+    begin(name)
+    try:
+        yield
+    finally:
+        end(name, **args)
+
+
+if _path:
+    instant("python_site_ready")
+    atexit.register(instant, "python_exit")
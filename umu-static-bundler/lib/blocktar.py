@@ -0,0 +1,264 @@
+"""
+Write a directory as a .tar.xz made of independent xz streams, reusing the
+streams whose members did not change since the last run.
+
+Members go in name order. A block of consecutive members ends after a name
+whose hash hits 1 in BOUNDARY, once it holds MAX_BLOCK bytes, or around any
+member of LARGE bytes or more, which gets a block of its own. Boundaries
+therefore follow names rather than offsets, and changing one file only
+changes its own block. Each block is compressed into its own xz stream and
+cached under a hash of its tar headers and file contents, so a rearchive
+after only umu-run changed compresses that one block. xz, tar -J and
+Python's lzma read the concatenated streams as one archive, and every stream
+starts a new xz index, so a reader can seek to a block without
+decompressing what comes before it.
+
+    python3 blocktar.py -C build proton-osu -o proton-osu.tar.xz \\
+        --cache .cache/archive-blocks [--compare]
+
+--compare also times XZ_OPT="-9 -T0" tar -Jcf on the same tree, the
+single-stream path this replaces, and prints both.
+"""
+
+import argparse
+import hashlib
+import json
+import lzma
+import os
+import stat
+import subprocess
+import sys
+import tarfile
+import time
+import zlib
+from concurrent.futures import ThreadPoolExecutor
+
+BOUNDARY = 256
+MAX_BLOCK = 64 << 20
+LARGE = 16 << 20
+# Two zero records end the archive, in a stream of their own
+END = b"\0" * (2 * tarfile.BLOCKSIZE)
+# What an xz -9 encoder allocates, to size the thread pool like xz -T0
+COMPRESSOR_MEMORY = 700 << 20
+
+
+class Member:
+    def __init__(self, name, path, info):
+        self.name = name
+        self.path = path
+        self.info = info
+        self.digest = None
+
+    def header(self):
+        return self.info.tobuf(tarfile.GNU_FORMAT, "utf-8",
+                               "surrogateescape")
+
+    def padded_size(self):
+        return -(-self.info.size // tarfile.BLOCKSIZE) * tarfile.BLOCKSIZE
+
+    def data(self):
+        if self.info.type != tarfile.REGTYPE:
+            return b""
+        with open(self.path, "rb") as f:
+            data = f.read()
+        return data + b"\0" * (-len(data) % tarfile.BLOCKSIZE)
+
+
+def tar_info(name, st):
+    info = tarfile.TarInfo(name)
+    info.mode = stat.S_IMODE(st.st_mode)
+    info.mtime = int(st.st_mtime)
+    info.uid = info.gid = 0
+    info.uname = info.gname = ""
+    return info
+
+
+def walk(root, name):
+    """Members of the tree, in name order, with hard links as tar does."""
+    links = {}
+    pending = [(name, os.path.join(root, name))]
+    while pending:
+        arcname, path = pending.pop()
+        st = os.lstat(path)
+        info = tar_info(arcname, st)
+        if stat.S_ISDIR(st.st_mode):
+            info.type = tarfile.DIRTYPE
+            pending += [(f"{arcname}/{entry}", os.path.join(path, entry))
+                        for entry in sorted(os.listdir(path), reverse=True)]
+        elif stat.S_ISLNK(st.st_mode):
+            info.type = tarfile.SYMTYPE
+            info.linkname = os.readlink(path)
+        elif stat.S_ISREG(st.st_mode):
+            inode = (st.st_dev, st.st_ino)
+            if st.st_nlink > 1 and inode in links:
+                info.type = tarfile.LNKTYPE
+                info.linkname = links[inode]
+            else:
+                links[inode] = arcname
+                info.size = st.st_size
+        else:
+            print(f"blocktar: skipping special file {path}", file=sys.stderr)
+            continue
+        yield Member(arcname, path, info), st
+
+
+def hash_contents(members, memo):
+    """Set each regular file's digest, reading only files whose size,
+    mtime or inode changed since the digest in memo was taken."""
+    for member, st in members:
+        if member.info.type == tarfile.REGTYPE:
+            seen = [st.st_size, st.st_mtime_ns, st.st_ino]
+            cached = memo.get(member.name)
+            if cached and cached[:3] == seen:
+                member.digest = cached[3]
+            else:
+                digest = hashlib.sha256()
+                with open(member.path, "rb") as f:
+                    while chunk := f.read(1 << 20):
+                        digest.update(chunk)
+                member.digest = digest.hexdigest()
+                memo[member.name] = seen + [member.digest]
+        yield member
+
+
+def blocks(members):
+    block, size = [], 0
+    for member in members:
+        if member.info.size >= LARGE and block:
+            yield block
+            block, size = [], 0
+        block.append(member)
+        size += member.info.size
+        if (size >= MAX_BLOCK or member.info.size >= LARGE or
+                zlib.crc32(member.name.encode("utf-8", "surrogateescape"))
+                % BOUNDARY == 0):
+            yield block
+            block, size = [], 0
+    if block:
+        yield block
+
+
+def block_key(block, preset):
+    key = hashlib.sha256(f"xz-{preset}\n".encode())
+    for member in block:
+        key.update(member.header())
+        key.update((member.digest or "").encode())
+    return key.hexdigest()
+
+
+def compress(block, path, preset):
+    data = b"".join(member.header() + member.data()
+                    for member in block) or END
+    compressed = lzma.compress(data, format=lzma.FORMAT_XZ, preset=preset)
+    tmp = f"{path}.{os.getpid()}.tmp"
+    with open(tmp, "wb") as f:
+        f.write(compressed)
+    os.replace(tmp, path)
+
+
+def default_jobs():
+    try:
+        with open("/proc/meminfo") as f:
+            total = next(int(line.split()[1]) << 10 for line in f
+                         if line.startswith("MemTotal:"))
+    except (OSError, StopIteration):
+        return os.cpu_count() or 1
+    # xz -T0 keeps to a quarter of RAM
+    return max(1, min(os.cpu_count() or 1, total // 4 // COMPRESSOR_MEMORY))
+
+
+def single_stream(root, name, output):
+    """Time the tar -J path this replaces."""
+    start = time.perf_counter()
+    subprocess.run(["tar", "-Jcf", output, "--numeric-owner", "--owner=0",
+                    "--group=0", "-C", root, name],
+                   env={**os.environ, "XZ_OPT": "-9 -T0"}, check=True)
+    return time.perf_counter() - start, os.path.getsize(output)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description="Write a tree as a multi-stream .tar.xz, reusing the "
+        "streams of unchanged blocks")
+    parser.add_argument("-C", "--directory", default=".",
+                        help="directory containing the tree")
+    parser.add_argument("name", help="tree to archive, relative to -C")
+    parser.add_argument("-o", "--output", required=True,
+                        help="the .tar.xz to write")
+    parser.add_argument("--cache", required=True,
+                        help="directory for the compressed blocks")
+    parser.add_argument("-j", "--jobs", type=int, default=default_jobs(),
+                        help="compression threads (default: by CPUs and "
+                        "memory, like xz -T0)")
+    parser.add_argument("--preset", type=int, default=9,
+                        help="xz preset (default 9)")
+    parser.add_argument("--compare", action="store_true",
+                        help="also time XZ_OPT='-9 -T0' tar -Jcf")
+    args = parser.parse_args(argv)
+
+    os.makedirs(args.cache, exist_ok=True)
+    memo_path = os.path.join(args.cache, "hashes.json")
+    try:
+        with open(memo_path) as f:
+            memo = json.load(f)
+    except (OSError, ValueError):
+        memo = {}
+
+    start = time.perf_counter()
+    members = hash_contents(walk(args.directory, args.name), memo)
+    plan = [(block, os.path.join(args.cache, block_key(block, args.preset)
+                                 + ".xz"))
+            for block in blocks(members)]
+    plan.append(([], os.path.join(args.cache, f"end-{args.preset}.xz")))
+
+    missing = {path: block for block, path in plan
+               if not os.path.exists(path)}
+    with ThreadPoolExecutor(max_workers=args.jobs) as pool:
+        for future in [pool.submit(compress, block, path, args.preset)
+                       for path, block in missing.items()]:
+            future.result()
+
+    tmp = args.output + ".tmp"
+    with open(tmp, "wb") as out:
+        for _, path in plan:
+            with open(path, "rb") as f:
+                while chunk := f.read(1 << 20):
+                    out.write(chunk)
+    os.replace(tmp, args.output)
+    elapsed = time.perf_counter() - start
+
+    # Only the blocks of this archive are worth keeping
+    used = {os.path.basename(path) for _, path in plan}
+    for entry in os.listdir(args.cache):
+        if entry.endswith(".xz") and entry not in used:
+            os.unlink(os.path.join(args.cache, entry))
+    names = {member.name for block, _ in plan for member in block}
+    with open(memo_path, "w") as f:
+        json.dump({name: seen for name, seen in memo.items()
+                   if name in names}, f)
+
+    raw = len(END) + sum(len(member.header()) + member.padded_size()
+                         for block, _ in plan for member in block)
+    size = os.path.getsize(args.output)
+    print(f"blocktar: {raw / 1e6:.1f} MB -> {size / 1e6:.1f} MB "
+          f"({raw / size:.2f}x) in {elapsed:.1f}s, {len(plan)} streams, "
+          f"{len(plan) - len(missing)} reused, {len(missing)} compressed "
+          f"on {args.jobs} threads")
+
+    if args.compare:
+        reference = args.output + ".single.tar.xz"
+        try:
+            ref_s, ref_size = single_stream(args.directory, args.name,
+                                            reference)
+        finally:
+            if os.path.exists(reference):
+                os.unlink(reference)
+        print(f"tar -J:   {raw / 1e6:.1f} MB -> {ref_size / 1e6:.1f} MB "
+              f"({raw / ref_size:.2f}x) in {ref_s:.1f}s; blocks are "
+              f"{100 * (size - ref_size) / ref_size:+.1f}% in size, "
+              f"{elapsed / ref_s if ref_s else 0:.2f}x the time")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -14,7 +14,7 @@ _repo_updater() {
     local repo_url="$3"
     local specific_ref="${4:-}"
     local is_new_clone=false
-    local timestamp=$(date +%Y%m%d%H%M%S)
+    local timestamp
 
     _message "Ensuring ${repo_path} is up-to-date."
 
@@ -159,6 +159,10 @@ _repo_updater() {
             git reset --hard origin/HEAD
         fi
 
+        # Tags carry the commit's date rather than the build's, so rebuilding
+        # the same commit gives the same version
+        timestamp=$(TZ=UTC git log -1 --format=%cd --date=format-local:%Y%m%d%H%M%S)
+
         # Keep submodules updated
         if [ -f ".gitmodules" ]; then
             _message "Updating submodules for ${repo_path}."
@@ -215,6 +219,7 @@ _repo_updater() {
     fi
     # Delete any old tags we made
     git tag -l "local-*" | xargs -r git tag -d
+    timestamp=$(TZ=UTC git log -1 --format=%cd --date=format-local:%Y%m%d%H%M%S)
     # Create a new "fake" tag at the current position with a timestamp, so that proton/protonfixes/umu-launcher is happy when versioning the build
     local current_branch=$(git rev-parse --abbrev-ref HEAD)
     local local_tag="local-${current_branch}-${timestamp}"
@@ -222,6 +227,90 @@ _repo_updater() {
     git tag -a -f "${local_tag}" -m "Local build tag for ${current_branch} at ${timestamp}" "${commit_hash}"
 }
 
+# Patches in a patch directory, in the order _patch_dir applies them
+# Usage: _patch_list <patch_dir>
+_patch_list() {
+    [ -d "$1" ] || return 0
+    find "$1" -type f -regex ".*\.patch" | LC_ALL=C sort -f
+}
+
+# One line per patch with its name and content hash, for keying a patched tree
+# Usage: _patch_series <patch_dir>
+_patch_series() {
+    local patch
+
+    _patch_list "$1" | while IFS= read -r patch; do
+        echo "${patch#"$1/"} $(sha256sum <"${patch}" | cut -d' ' -f1)"
+    done
+}
+
+# Whether a repository is at a commit _patch_commit made with this key and
+# nothing changed since. Paths after the key are left out of the check.
+# Usage: _patched_at <repo> <key> [<excluded path>...]
+_patched_at() {
+    local repo="$1"
+    local key="$2"
+    shift 2
+    local excludes=()
+    local path
+
+    for path in "$@"; do
+        excludes+=(":(exclude)${path}")
+    done
+
+    [ -e "${repo}/.git" ] || return 1
+    [ "$(git -C "${repo}" log -1 --format='%(trailers:key=Patch-series,valueonly)' 2>/dev/null)" = "${key}" ] || return 1
+    [ -z "$(git -C "${repo}" status --porcelain -- . "${excludes[@]}")" ]
+}
+
+# Commit a patched tree, submodules before the repositories containing them,
+# with the key as a Patch-series trailer. A later build that finds the same
+# key with _patched_at can then leave every file, and its mtime, alone. Local
+# version tags move to the new commits so versioning is unchanged.
+# Usage: _patch_commit <repo> <key> [<excluded path>...]
+_patch_commit() {
+    local repo="$1"
+    local key="$2"
+    shift 2
+    local excludes=()
+    local submodules=()
+    local path i
+
+    for path in "$@"; do
+        excludes+=(":(exclude)${path}")
+    done
+
+    # shellcheck disable=SC2016
+    mapfile -t submodules < <(git -C "${repo}" submodule foreach --recursive --quiet 'echo "${displaypath}"')
+    for ((i = ${#submodules[@]} - 1; i >= 0; i--)); do
+        _commit_tree "${repo}/${submodules[i]}" "${key}" || return 1
+    done
+    _commit_tree "${repo}" "${key}" "${excludes[@]}"
+}
+
+# Usage: _commit_tree <dir> <key> [<pathspec>...]
+_commit_tree() {
+    local dir="$1"
+    local key="$2"
+    shift 2
+    local tags tag
+
+    [ -z "$(git -C "${dir}" status --porcelain -- . "$@")" ] && return 0
+
+    tags=$(git -C "${dir}" tag -l "local-*" --points-at HEAD)
+    # Commit on a detached HEAD, so a checked-out branch keeps pointing at
+    # the base and _repo_updater resets to it when the key changes
+    git -C "${dir}" checkout -q --detach || return 1
+    git -C "${dir}" add -A -- . "$@" || return 1
+    GIT_AUTHOR_NAME="umubuilder" GIT_AUTHOR_EMAIL="proton@umu.builder" \
+        GIT_COMMITTER_NAME="umubuilder" GIT_COMMITTER_EMAIL="proton@umu.builder" \
+        git -C "${dir}" commit -q --no-verify --no-gpg-sign \
+        -m "Apply local patch series" -m "Patch-series: ${key}" || return 1
+    for tag in ${tags}; do
+        git -C "${dir}" tag -a -f "${tag}" -m "$(git -C "${dir}" tag -l --format='%(contents)' "${tag}")" HEAD >/dev/null
+    done
+}
+
 # Apply patches to a target directory following a structured patch directory layout
 # Usage: _patch_dir <target_dir> <patch_dir> [<patch_opts>...]
 # Example: _patch_dir "${srcdir}/wine" "${patchdir}/wine" ["extra_opts"...]
@@ -237,8 +326,7 @@ _patch_dir() {
 
     cd "${target_dir}" || _failure "Failed to change to target directory: ${target_dir}"
 
-    # Find and sort patches
-    mapfile -t patchlist < <(find "${patch_dir}" -type f -regex ".*\.patch" | LC_ALL=C sort -f)
+    mapfile -t patchlist < <(_patch_list "${patch_dir}")
 
     # Apply each patch
     for patch in "${patchlist[@]}"; do
@@ -0,0 +1,102 @@
+#!/bin/bash
+# Content-addressed cache for build stages
+#
+# Each stage hashes everything its output depends on into a key, and keeps
+# its output in ${STAGE_CACHE_DIR}/<stage>/<key>. A stage whose key is
+# present is restored instead of rebuilt. The most recently used
+# STAGE_CACHE_KEEP entries per stage are kept, so switching back and forth
+# between options does not rebuild either.
+#
+# Callers set STAGE_CACHE_DIR, and STAGE_CACHE_VERSION (bumped whenever the
+# way a stage is built changes in a way its inputs do not show).
+
+: "${STAGE_CACHE_KEEP:=3}"
+
+# Hash the files under each path, by relative name and content
+# Usage: _hash_paths <file or dir>...
+_hash_paths() {
+    local path
+
+    for path in "$@"; do
+        if [[ -d "${path}" ]]; then
+            (cd "${path}" && find . -name __pycache__ -prune -o -type f -print0 |
+                LC_ALL=C sort -z | xargs -0 -r sha256sum)
+        elif [[ -f "${path}" ]]; then
+            (cd "$(dirname "${path}")" && sha256sum "$(basename "${path}")")
+        else
+            echo "missing ${path}"
+        fi
+    done | sha256sum | cut -c1-16
+}
+
+# Print the key for a stage whose inputs are given on stdin, one per line,
+# and keep the inputs next to the entry to explain a rebuild
+# Usage: _stage_key <stage> <<EOF ... EOF
+_stage_key() {
+    local stage="$1"
+    local inputs key
+
+    inputs="stage_cache_version=${STAGE_CACHE_VERSION}"$'\n'"$(cat)"
+    key=$(printf '%s\n' "${inputs}" | sha256sum | cut -c1-16)
+
+    mkdir -p "${STAGE_CACHE_DIR}/${stage}"
+    printf '%s\n' "${inputs}" > "${STAGE_CACHE_DIR}/${stage}/${key}.inputs"
+    echo "${key}"
+}
+
+_stage_hit() {
+    [[ -d "${STAGE_CACHE_DIR}/$1/$2" ]]
+}
+
+# Copy a cached stage's output into a directory
+# Usage: _stage_restore <stage> <key> <dest dir>
+_stage_restore() {
+    local entry="${STAGE_CACHE_DIR}/$1/$2"
+
+    _stage_hit "$1" "$2" || return 1
+    mkdir -p "$3"
+    cp -a --reflink=auto "${entry}/." "$3/" || return 1
+    touch "${entry}"
+}
+
+# Store paths (relative to a base directory) as a stage's output. The entry
+# is written under a temporary name and renamed, so an interrupted build
+# never leaves a partial entry behind.
+# Usage: _stage_save <stage> <key> <base dir> <path>...
+_stage_save() {
+    local stage="$1"
+    local key="$2"
+    local base="$3"
+    shift 3
+    local stage_dir="${STAGE_CACHE_DIR}/${stage}"
+    local tmp="${stage_dir}/.${key}.tmp"
+
+    mkdir -p "${stage_dir}"
+    rm -rf "${tmp}" "${stage_dir:?}/${key}"
+    mkdir "${tmp}"
+    if ! tar -C "${base}" -cf - "$@" | tar -C "${tmp}" -xf -; then
+        rm -rf "${tmp}"
+        _warning "Could not cache the ${stage} stage"
+        return 0
+    fi
+    mv "${tmp}" "${stage_dir}/${key}"
+
+    _stage_prune "${stage}"
+}
+
+# Drop all but the most recently used entries of a stage, and the inputs
+# of keys that were never built
+_stage_prune() {
+    local stage_dir="${STAGE_CACHE_DIR}/$1"
+    local old inputs
+
+    while IFS= read -r old; do
+        rm -rf "${stage_dir:?}/${old}" "${stage_dir}/${old}.inputs"
+    done < <(find "${stage_dir}" -mindepth 1 -maxdepth 1 -type d \
+                -not -name '.*' -printf '%T@ %f\n' |
+             sort -rn | tail -n +$((STAGE_CACHE_KEEP + 1)) | cut -d' ' -f2)
+
+    for inputs in "${stage_dir}"/*.inputs; do
+        [[ -d "${inputs%.inputs}" ]] || rm -f "${inputs}"
+    done
+}
@@ -0,0 +1,95 @@
+#!/bin/bash
+# Run build steps as a dependency graph
+#
+# Steps are declared with _step and run by _run_steps, each in its own
+# subshell as soon as the steps it depends on have finished, so independent
+# downloads and extractions overlap. A step's output goes to
+# <log dir>/<step>.log. When one fails no further steps are started, the
+# running ones are waited for, and its log is shown.
+
+declare -a _STEP_ORDER=()
+declare -A _STEP_DEPS=()
+declare -A _STEP_COMMANDS=()
+
+# Declare a step
+# Usage: _step <name> "<dependency>..." <command> [args...]
+_step() {
+    local name="$1"
+    local deps="$2"
+    shift 2
+
+    _STEP_ORDER+=("${name}")
+    _STEP_DEPS["${name}"]="${deps}"
+    _STEP_COMMANDS["${name}"]="$(printf '%q ' "$@")"
+}
+
+# Run the declared steps, then forget them. Exits if any fails; call it as
+# a plain command, since under if or || the steps would run without set -e
+# Usage: _run_steps <log dir>
+_run_steps() {
+    local log_dir="$1"
+    local -A state=()
+    local -A pids=()
+    local -A started=()
+    local name dep ready status
+    local running=0
+    local failed=()
+    local skipped=()
+
+    mkdir -p "${log_dir}"
+
+    while true; do
+        if [[ ${#failed[@]} -eq 0 ]]; then
+            for name in "${_STEP_ORDER[@]}"; do
+                [[ -z "${state[${name}]:-}" ]] || continue
+                ready=true
+                for dep in ${_STEP_DEPS[${name}]}; do
+                    [[ "${state[${dep}]:-}" == done ]] || ready=false
+                done
+                ${ready} || continue
+
+                (eval "${_STEP_COMMANDS[${name}]}") \
+                    < /dev/null > "${log_dir}/${name}.log" 2>&1 &
+                pids["${name}"]=$!
+                started["${name}"]=${SECONDS}
+                state["${name}"]=running
+                running=$((running + 1))
+            done
+        fi
+        [[ ${running} -gt 0 ]] || break
+
+        wait -n || true
+        for name in "${!pids[@]}"; do
+            [[ "${state[${name}]}" == running ]] || continue
+            kill -0 "${pids[${name}]}" 2> /dev/null && continue
+
+            status=0
+            wait "${pids[${name}]}" || status=$?
+            running=$((running - 1))
+            if [[ ${status} -eq 0 ]]; then
+                state["${name}"]=done
+                _message "${name}: done in $((SECONDS - started[${name}]))s"
+            else
+                state["${name}"]=failed
+                failed+=("${name}")
+                _error "${name}: failed (exit ${status}), log in ${log_dir}/${name}.log"
+                tail -n 20 "${log_dir}/${name}.log" | sed 's/^/    /' >&2
+            fi
+        done
+    done
+
+    for name in "${_STEP_ORDER[@]}"; do
+        [[ -n "${state[${name}]:-}" ]] || skipped+=("${name}")
+    done
+    _STEP_ORDER=()
+    _STEP_DEPS=()
+    _STEP_COMMANDS=()
+
+    if [[ ${#failed[@]} -gt 0 ]]; then
+        [[ ${#skipped[@]} -eq 0 ]] || _warning "Not started: ${skipped[*]}"
+        _failure "Failed: ${failed[*]}"
+    fi
+    if [[ ${#skipped[@]} -gt 0 ]]; then
+        _failure "Steps with unknown or circular dependencies: ${skipped[*]}"
+    fi
+}
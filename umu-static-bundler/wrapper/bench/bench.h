@@ -0,0 +1,161 @@
+#ifndef WRAPPER_BENCH_H
+#define WRAPPER_BENCH_H
+
+/* Shared helpers for the benchmark programs. These link against the wrapper
+ * objects, so wrapper.h comes first for _GNU_SOURCE. */
+#include "wrapper.h"
+#include <stdint.h>
+#include <time.h>
+
+/* Monotonic time in nanoseconds */
+static inline uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Keep the compiler from discarding a computed value */
+static inline void bench_consume(uint64_t value) {
+  __asm__ __volatile__("" : : "r"(value) : "memory");
+}
+
+/* Summary of a set of samples */
+struct bench_stats {
+  size_t runs;
+  uint64_t min, p50, p95, p99, max;
+  double mean;
+};
+
+static inline int bench_compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* Sort values in place and summarise them (nearest-rank percentiles) */
+static inline struct bench_stats bench_summarize(uint64_t *values, size_t n) {
+  struct bench_stats st = {.runs = n};
+  double sum = 0;
+
+  if (n == 0) {
+    return st;
+  }
+
+  qsort(values, n, sizeof(*values), bench_compare_u64);
+  for (size_t i = 0; i < n; i++) {
+    sum += (double)values[i];
+  }
+  st.min = values[0];
+  st.p50 = values[(50 * n + 99) / 100 - 1];
+  st.p95 = values[(95 * n + 99) / 100 - 1];
+  st.p99 = values[(99 * n + 99) / 100 - 1];
+  st.max = values[n - 1];
+  st.mean = sum / (double)n;
+  return st;
+}
+
+/* Open the JSON results file: path if given, else $BENCH_JSON (set by
+ * `make bench`). Returns NULL if neither names a file. */
+static inline FILE *bench_json_open(const char *path) {
+  if (!path || !*path) {
+    path = getenv("BENCH_JSON");
+  }
+  if (!path || !*path) {
+    return NULL;
+  }
+
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+  }
+  return f;
+}
+
+/* Read a newline-separated corpus file into a NULL-terminated array.
+ * Returns the number of lines read, or -1 on error. */
+static inline long bench_read_lines(const char *path, char ***lines_out) {
+  FILE *f = fopen(path, "r");
+  char **lines = NULL;
+  char *line = NULL;
+  size_t cap = 0, count = 0, alloc = 0;
+  ssize_t len;
+
+  if (!f) {
+    return -1;
+  }
+
+  while ((len = getline(&line, &cap, f)) != -1) {
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len == 0) {
+      continue;
+    }
+    if (count + 1 >= alloc) {
+      alloc = alloc ? alloc * 2 : 1024;
+      char **grown = realloc(lines, alloc * sizeof(*lines));
+      if (!grown) {
+        break;
+      }
+      lines = grown;
+    }
+    lines[count++] = strdup(line);
+  }
+
+  free(line);
+  fclose(f);
+  if (lines) {
+    lines[count] = NULL;
+  }
+  *lines_out = lines;
+  return (long)count;
+}
+
+/* A stdlib-like archive listing (directories, modules, extension modules and
+ * headers under ./python/, plus the app), for when no real corpus is given.
+ * Returns a NULL-terminated array, or NULL on allocation failure. */
+static inline char **bench_stdlib_corpus(size_t *count) {
+  static const char *dirs[] = {
+      "lib/python3.13",          "lib/python3.13/asyncio",
+      "lib/python3.13/collections", "lib/python3.13/concurrent/futures",
+      "lib/python3.13/email/mime", "lib/python3.13/encodings",
+      "lib/python3.13/importlib/metadata", "lib/python3.13/json",
+      "lib/python3.13/lib-dynload", "lib/python3.13/logging",
+      "lib/python3.13/urllib",   "lib/python3.13/xml/etree",
+      "bin",                     "include/python3.13/internal"};
+  static const char *files[] = {
+      "__init__.py", "base_events.py", "selector_events.py",
+      "_bootstrap_external.py", "utf_8.py", "decoder.py", "handlers.py",
+      "_ssl.cpython-313-x86_64-linux-musl.so", "thread.py", "parse.py",
+      "ElementTree.py", "pycore_global_objects_fini_generated.h"};
+  size_t ndirs = sizeof(dirs) / sizeof(dirs[0]);
+  size_t nfiles = sizeof(files) / sizeof(files[0]);
+  size_t total = ndirs * (nfiles + 1) * 8 + 3;
+  char **names = calloc(total + 1, sizeof(char *));
+  size_t n = 0;
+  char buf[PATH_MAX];
+
+  if (!names) {
+    return NULL;
+  }
+
+  for (int copy = 0; copy < 8; copy++) {
+    for (size_t d = 0; d < ndirs; d++) {
+      snprintf(buf, sizeof(buf), "./python/%s/", dirs[d]);
+      names[n++] = strdup(buf);
+      for (size_t f = 0; f < nfiles; f++) {
+        snprintf(buf, sizeof(buf), "./python/%s/%s%.0d", dirs[d], files[f],
+                 copy);
+        names[n++] = strdup(buf);
+      }
+    }
+  }
+  names[n++] = strdup("./apps/");
+  names[n++] = strdup("./apps/umu-run/bin/umu-run");
+  names[n++] = strdup("./apps/umu-run/umu_version.json");
+
+  *count = n;
+  return names;
+}
+
+#endif /* WRAPPER_BENCH_H */
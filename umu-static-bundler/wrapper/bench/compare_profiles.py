@@ -0,0 +1,65 @@
+"""
+Size and speed of the wrapper's size (-Oz) and perf (-O2, LTO, PGO) build
+profiles, from the results make compare-profiles leaves in each directory:
+the binary plus extract_bench.json and startup_bench.json.
+
+Usage: compare_profiles.py <binary name> <size dir> <perf dir>
+"""
+
+import json
+import os
+import sys
+
+
+def load(directory, name):
+    try:
+        with open(os.path.join(directory, name)) as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return None
+
+
+def row(label, size, perf, unit, lower_is_better=True):
+    if size is None or perf is None:
+        print(f"  {label:<34} {'-':>12} {'-':>12}")
+        return
+    change = (perf - size) / size * 100 if size else 0.0
+    better = change < 0 if lower_is_better else change > 0
+    print(f"  {label:<34} {size:>9.1f} {unit:<4} {perf:>9.1f} {unit:<4} "
+          f"{change:+7.1f}%{'  (better)' if better and change else ''}")
+
+
+def main(argv):
+    if len(argv) != 4:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 2
+    binary, size_dir, perf_dir = argv[1:]
+
+    print(f"  {'':<34} {'size':>14} {'perf':>14}   change")
+    sizes = [os.path.getsize(os.path.join(d, binary))
+             if os.path.exists(os.path.join(d, binary)) else None
+             for d in (size_dir, perf_dir)]
+    row("binary size", *(s / 1024 if s else None for s in sizes), "KB")
+
+    startup = [load(d, "startup_bench.json") for d in (size_dir, perf_dir)]
+    if all(startup):
+        for scenario in startup[0]["scenarios"]:
+            values = [s["scenarios"].get(scenario, {}).get("p50")
+                      for s in startup]
+            row(f"startup {scenario} p50", *(v / 1000 if v else None
+                                             for v in values), "ms")
+
+    extract = [load(d, "extract_bench.json") for d in (size_dir, perf_dir)]
+    if all(extract):
+        for size_target, perf_target in zip(extract[0]["targets"],
+                                            extract[1]["targets"]):
+            where = size_target["dir"]
+            row(f"extract {where}", size_target["extract_us"] / 1000,
+                perf_target["extract_us"] / 1000, "ms")
+            row(f"extract {where} throughput", size_target["mb_s"],
+                perf_target["mb_s"], "MB/s", lower_is_better=False)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
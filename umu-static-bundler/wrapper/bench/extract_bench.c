@@ -0,0 +1,481 @@
+/* Extraction throughput of extract_bundled_archive
+ *
+ * Generates a synthetic bundle (see payload.h), or takes a real one with -B,
+ * and extracts it into each target directory -n times. Every run happens in a fresh child process so
+ * peak RSS and CPU time belong to that run alone. Per run it records, for
+ * the python section, the apps section and removing the result again:
+ * wall time, user and system CPU, and read/write syscalls (from
+ * /proc/self/io). Medians are reported along with MB/s and files/s for the
+ * two extraction phases combined.
+ *
+ * Usage: extract_bench [-f files] [-s stdlib|so|mixed] [-z codec]
+ *                      [-l level] [-F per-file|max=<bytes>] [-n runs]
+ *                      [-t target-dir]... [-C] [-G bundle] [-B bundle]
+ *                      [-o results.json]
+ *
+ *   -C  evict the bundle from the page cache before every run
+ *   -G  only write the generated bundle to the given path
+ *   -B  benchmark an existing bundle; the payload options are ignored
+ *
+ * Targets default to /dev/shm (tmpfs) and /var/tmp (usually a real
+ * filesystem).
+ */
+#include "bench.h"
+#include "logging.h"
+#include "pathutils.h"
+#include "payload.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAX_TARGETS 8
+
+enum phase { PHASE_PYTHON, PHASE_APPS, PHASE_CLEANUP, PHASE_COUNT };
+
+static const char *phase_names[PHASE_COUNT] = {[PHASE_PYTHON] = "python",
+                                               [PHASE_APPS] = "apps",
+                                               [PHASE_CLEANUP] = "cleanup"};
+
+struct phase_sample {
+  uint64_t wall_us;
+  uint64_t user_us;
+  uint64_t sys_us;
+  uint64_t syscr; /* read-type syscalls */
+  uint64_t syscw; /* write-type syscalls */
+};
+
+/* What a child run sends back */
+struct run_sample {
+  int ok;
+  struct phase_sample phases[PHASE_COUNT];
+};
+
+/* A run as seen by the parent */
+struct run_result {
+  struct run_sample sample;
+  uint64_t max_rss_kb;
+};
+
+struct phase_counters {
+  uint64_t wall_ns;
+  struct rusage ru;
+  uint64_t syscr, syscw;
+};
+
+static uint64_t timeval_us(struct timeval tv) {
+  return (uint64_t)tv.tv_sec * 1000000u + (uint64_t)tv.tv_usec;
+}
+
+/* read/write syscall counters for this process */
+static void read_io_counters(uint64_t *syscr, uint64_t *syscw) {
+  char line[128];
+  FILE *f = fopen("/proc/self/io", "r");
+
+  *syscr = *syscw = 0;
+  if (!f) {
+    return;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long long v;
+    if (sscanf(line, "syscr: %llu", &v) == 1) {
+      *syscr = v;
+    } else if (sscanf(line, "syscw: %llu", &v) == 1) {
+      *syscw = v;
+    }
+  }
+  fclose(f);
+}
+
+static void snapshot(struct phase_counters *c) {
+  read_io_counters(&c->syscr, &c->syscw);
+  getrusage(RUSAGE_SELF, &c->ru);
+  c->wall_ns = bench_now_ns();
+}
+
+static void phase_delta(struct phase_sample *out,
+                        const struct phase_counters *a,
+                        const struct phase_counters *b) {
+  out->wall_us = (b->wall_ns - a->wall_ns) / 1000;
+  out->user_us = timeval_us(b->ru.ru_utime) - timeval_us(a->ru.ru_utime);
+  out->sys_us = timeval_us(b->ru.ru_stime) - timeval_us(a->ru.ru_stime);
+  /* syscr includes the read of /proc/self/io that took snapshot b */
+  out->syscr = b->syscr - a->syscr;
+  out->syscw = b->syscw - a->syscw;
+}
+
+/* Child side: extract both sections, remove the result, report */
+static void run_child(const char *bundle, const char *target, int out_fd) {
+  struct run_sample sample = {0};
+  struct phase_counters c[PHASE_COUNT + 1];
+
+  snapshot(&c[0]);
+  sample.ok = extract_bundled_archive(bundle, target, INSTALL_PYTHON) == WRP_OK;
+  snapshot(&c[1]);
+  sample.ok &= extract_bundled_archive(bundle, target, INSTALL_APP) == WRP_OK;
+  snapshot(&c[2]);
+  remove_directory_recursive(target);
+  snapshot(&c[3]);
+
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    phase_delta(&sample.phases[p], &c[p], &c[p + 1]);
+  }
+  _exit(write(out_fd, &sample, sizeof(sample)) == (ssize_t)sizeof(sample)
+            ? 0
+            : 1);
+}
+
+static int run_once(const char *bundle, const char *target, int evict,
+                    struct run_result *res) {
+  int pipefd[2];
+  int status;
+  struct rusage ru;
+
+  memset(res, 0, sizeof(*res));
+  remove_directory_recursive(target);
+
+  if (evict) {
+    int fd = open(bundle, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+
+  if (pipe(pipefd) != 0) {
+    return -1;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(pipefd[0]);
+    run_child(bundle, target, pipefd[1]);
+  }
+  close(pipefd[1]);
+  if (pid < 0) {
+    close(pipefd[0]);
+    return -1;
+  }
+
+  ssize_t n = read(pipefd[0], &res->sample, sizeof(res->sample));
+  close(pipefd[0]);
+  if (wait4(pid, &status, 0, &ru) != pid || n != (ssize_t)sizeof(res->sample)) {
+    return -1;
+  }
+  res->max_rss_kb = (uint64_t)ru.ru_maxrss;
+  return res->sample.ok ? 0 : -1;
+}
+
+struct target_report {
+  const char *dir;
+  size_t runs;
+  size_t failures;
+  uint64_t extract_us;                     /* Median of both extract phases */
+  uint64_t max_rss_kb;                     /* Largest peak RSS of any run */
+  struct phase_sample phases[PHASE_COUNT]; /* Medians per field */
+};
+
+static uint64_t median(uint64_t *values, size_t n) {
+  return n ? bench_summarize(values, n).p50 : 0;
+}
+
+static struct target_report bench_target(const char *bundle,
+                                         const char *target_root, size_t runs,
+                                         int evict) {
+  struct target_report rep = {.dir = target_root};
+  struct run_result *results = calloc(runs, sizeof(*results));
+  uint64_t *values = calloc(runs, sizeof(*values));
+  char target[PATH_MAX];
+
+  if (!results || !values ||
+      path_join(target, sizeof(target), target_root, "extract-bench.tmp",
+                NULL) != WRP_OK) {
+    free(results);
+    free(values);
+    rep.failures = runs;
+    return rep;
+  }
+
+  for (size_t i = 0; i < runs; i++) {
+    if (run_once(bundle, target, evict, &results[rep.runs]) == 0) {
+      rep.runs++;
+    } else {
+      rep.failures++;
+    }
+  }
+  remove_directory_recursive(target);
+
+#define PHASE_MEDIAN(p, field)                                                 \
+  do {                                                                         \
+    for (size_t i = 0; i < rep.runs; i++) {                                    \
+      values[i] = results[i].sample.phases[p].field;                           \
+    }                                                                          \
+    rep.phases[p].field = median(values, rep.runs);                            \
+  } while (0)
+
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    PHASE_MEDIAN(p, wall_us);
+    PHASE_MEDIAN(p, user_us);
+    PHASE_MEDIAN(p, sys_us);
+    PHASE_MEDIAN(p, syscr);
+    PHASE_MEDIAN(p, syscw);
+  }
+#undef PHASE_MEDIAN
+
+  for (size_t i = 0; i < rep.runs; i++) {
+    values[i] = results[i].sample.phases[PHASE_PYTHON].wall_us +
+                results[i].sample.phases[PHASE_APPS].wall_us;
+    if (results[i].max_rss_kb > rep.max_rss_kb) {
+      rep.max_rss_kb = results[i].max_rss_kb;
+    }
+  }
+  rep.extract_us = median(values, rep.runs);
+
+  free(results);
+  free(values);
+  return rep;
+}
+
+static double rate(double amount, uint64_t us) {
+  return us ? amount / ((double)us / 1e6) : 0;
+}
+
+static void print_report(const struct target_report *rep,
+                         const struct payload_info *info) {
+  printf("\n%s: %zu runs, %zu failed\n", rep->dir, rep->runs, rep->failures);
+  if (rep->runs == 0) {
+    return;
+  }
+  printf("  extract %.1f ms, %.1f MB/s, %.0f files/s, peak RSS %llu KiB\n",
+         rep->extract_us / 1000.0,
+         rate((double)info->raw / 1e6, rep->extract_us),
+         rate((double)info->entries, rep->extract_us),
+         (unsigned long long)rep->max_rss_kb);
+  printf("  %-8s %10s %10s %10s %8s %8s\n", "phase", "wall ms", "user ms",
+         "sys ms", "reads", "writes");
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    const struct phase_sample *ph = &rep->phases[p];
+    printf("  %-8s %10.1f %10.1f %10.1f %8llu %8llu\n", phase_names[p],
+           ph->wall_us / 1000.0, ph->user_us / 1000.0, ph->sys_us / 1000.0,
+           (unsigned long long)ph->syscr, (unsigned long long)ph->syscw);
+  }
+}
+
+static void print_json(FILE *f, const struct payload_spec *spec,
+                       const char *existing, const struct payload_info *info,
+                       const struct target_report *reps, size_t nreps,
+                       int evict) {
+  static const char *dist_names[] = {[PAYLOAD_STDLIB] = "stdlib",
+                                     [PAYLOAD_SO] = "so",
+                                     [PAYLOAD_MIXED] = "mixed"};
+
+  fprintf(f, "{\n  \"bench\": \"extract\",\n");
+  if (existing) {
+    fprintf(f,
+            "  \"payload\": {\"bundle\": \"%s\", \"entries\": %zu, "
+            "\"raw_bytes\": %llu, \"archive_bytes\": %lld},\n",
+            existing, info->entries, info->raw, info->archive_bytes);
+  } else {
+    fprintf(f,
+            "  \"payload\": {\"files\": %zu, \"dist\": \"%s\", "
+            "\"codec\": \"%s\", \"level\": %d, \"frames\": \"%s\", "
+            "\"entries\": %zu, \"raw_bytes\": %llu, \"archive_bytes\": "
+            "%lld},\n",
+            spec->files, dist_names[spec->dist], spec->codec, spec->level,
+            spec->frames ? spec->frames : "single", info->entries, info->raw,
+            info->archive_bytes);
+  }
+  fprintf(f, "  \"evict_page_cache\": %s,\n", evict ? "true" : "false");
+  fprintf(f, "  \"targets\": [");
+  for (size_t t = 0; t < nreps; t++) {
+    const struct target_report *rep = &reps[t];
+    fprintf(f,
+            "%s\n    {\"dir\": \"%s\", \"runs\": %zu, \"failures\": %zu, "
+            "\"extract_us\": %llu, \"mb_s\": %.1f, \"files_s\": %.0f, "
+            "\"max_rss_kb\": %llu, \"phases\": {",
+            t ? "," : "", rep->dir, rep->runs, rep->failures,
+            (unsigned long long)rep->extract_us,
+            rate((double)info->raw / 1e6, rep->extract_us),
+            rate((double)info->entries, rep->extract_us),
+            (unsigned long long)rep->max_rss_kb);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      const struct phase_sample *ph = &rep->phases[p];
+      fprintf(f,
+              "%s\n      \"%s\": {\"wall_us\": %llu, \"user_us\": %llu, "
+              "\"sys_us\": %llu, \"syscr\": %llu, \"syscw\": %llu}",
+              p ? "," : "", phase_names[p], (unsigned long long)ph->wall_us,
+              (unsigned long long)ph->user_us, (unsigned long long)ph->sys_us,
+              (unsigned long long)ph->syscr, (unsigned long long)ph->syscw);
+    }
+    fprintf(f, "\n    }}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+/* Bench every target and write the reports */
+static int run_targets(const char *bundle, const struct payload_spec *spec,
+                       const char *existing, const struct payload_info *info,
+                       const char *const *targets, size_t ntargets,
+                       size_t runs, int evict, const char *json_path) {
+  struct target_report reports[MAX_TARGETS];
+  int failed = 0;
+
+  for (size_t t = 0; t < ntargets; t++) {
+    reports[t] = bench_target(bundle, targets[t], runs, evict);
+    print_report(&reports[t], info);
+    failed |= reports[t].runs == 0;
+  }
+
+  FILE *json = bench_json_open(json_path);
+  if (json) {
+    print_json(json, spec, existing, info, reports, ntargets, evict);
+    fclose(json);
+  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+  static const char python_stub[] = "#!/bin/sh\nexit 0\n";
+  struct payload_spec spec = {.files = 2000,
+                              .dist = PAYLOAD_STDLIB,
+                              .codec = "zstd",
+                              .level = -1,
+                              .python_bin = python_stub,
+                              .python_bin_size = sizeof(python_stub) - 1};
+  struct payload_info info;
+  const char *targets[MAX_TARGETS];
+  const char *json_path = NULL;
+  const char *generate_only = NULL;
+  const char *existing = NULL;
+  size_t ntargets = 0;
+  size_t runs = 5;
+  int evict = 0;
+  int opt;
+
+  /* Keep the per-section progress messages out of the report */
+  log_init(LOG_WARNING, 0);
+
+  while ((opt = getopt(argc, argv, "f:s:z:l:F:n:t:CG:B:o:")) != -1) {
+    switch (opt) {
+    case 'f':
+      spec.files = strtoul(optarg, NULL, 10);
+      break;
+    case 's':
+      if (strcmp(optarg, "stdlib") == 0) {
+        spec.dist = PAYLOAD_STDLIB;
+      } else if (strcmp(optarg, "so") == 0) {
+        spec.dist = PAYLOAD_SO;
+      } else if (strcmp(optarg, "mixed") == 0) {
+        spec.dist = PAYLOAD_MIXED;
+      } else {
+        fprintf(stderr, "Unknown size distribution: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'z':
+      spec.codec = optarg;
+      break;
+    case 'l':
+      spec.level = atoi(optarg);
+      break;
+    case 'F':
+      spec.frames = optarg;
+      break;
+    case 'n':
+      runs = strtoul(optarg, NULL, 10);
+      break;
+    case 't':
+      if (ntargets == MAX_TARGETS) {
+        fprintf(stderr, "At most %d targets\n", MAX_TARGETS);
+        return EXIT_FAILURE;
+      }
+      targets[ntargets++] = optarg;
+      break;
+    case 'C':
+      evict = 1;
+      break;
+    case 'G':
+      generate_only = optarg;
+      break;
+    case 'B':
+      existing = optarg;
+      break;
+    case 'o':
+      json_path = optarg;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-f files] [-s stdlib|so|mixed] [-z codec] "
+              "[-l level] [-F per-file|max=<bytes>] [-n runs] "
+              "[-t target-dir]... [-C] [-G bundle] [-B bundle] "
+              "[-o results.json]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* Match the level the release build uses unless told otherwise */
+  if (spec.level < 0 && strcmp(spec.codec, "zstd") == 0) {
+    spec.level = 19;
+  }
+
+  if (ntargets == 0) {
+    targets[ntargets++] = "/dev/shm";
+    targets[ntargets++] = "/var/tmp";
+  }
+
+  char work_dir[PATH_MAX];
+  char archive_path[PATH_MAX];
+  char bundle[PATH_MAX];
+  const char *tmp = getenv("TMPDIR");
+
+  if (existing) {
+    if (payload_read_bundle(existing, &info) != 0) {
+      return EXIT_FAILURE;
+    }
+    printf("Payload: %zu entries, %.1f MB raw, %.1f MB (%.2fx) in %s\n",
+           info.entries, (double)info.raw / 1e6,
+           (double)info.archive_bytes / 1e6,
+           info.archive_bytes ? (double)info.raw / (double)info.archive_bytes
+                              : 0,
+           existing);
+    return run_targets(existing, &spec, existing, &info, targets, ntargets,
+                       runs, evict, json_path);
+  }
+
+  snprintf(work_dir, sizeof(work_dir), "%s/extract-bench.XXXXXX",
+           tmp && *tmp ? tmp : "/tmp");
+  if (!mkdtemp(work_dir)) {
+    fprintf(stderr, "Failed to create work directory: %s\n", strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  uint64_t gen_start = bench_now_ns();
+  if (path_join(archive_path, sizeof(archive_path), work_dir, "payload.tar",
+                NULL) != WRP_OK ||
+      path_join(bundle, sizeof(bundle), work_dir, "bundle", NULL) != WRP_OK ||
+      payload_write_archive(archive_path, &spec, &info) != 0 ||
+      payload_write_bundle(generate_only ? generate_only : bundle, NULL,
+                           archive_path, &info) != 0) {
+    fprintf(stderr, "Failed to generate payload\n");
+    remove_directory_recursive(work_dir);
+    return EXIT_FAILURE;
+  }
+  unlink(archive_path);
+
+  printf("Payload: %zu entries, %.1f MB raw, %.1f MB %s level %d (%.2fx), "
+         "generated in %.1f s\n",
+         info.entries, (double)info.raw / 1e6,
+         (double)info.archive_bytes / 1e6, spec.codec, spec.level,
+         info.archive_bytes ? (double)info.raw / (double)info.archive_bytes : 0,
+         (double)(bench_now_ns() - gen_start) / 1e9);
+
+  if (generate_only) {
+    remove_directory_recursive(work_dir);
+    return EXIT_SUCCESS;
+  }
+
+  int rc = run_targets(bundle, &spec, NULL, &info, targets, ntargets, runs,
+                       evict, json_path);
+  remove_directory_recursive(work_dir);
+  return rc;
+}
@@ -0,0 +1,419 @@
+/* Installation lock contention stress
+ *
+ * Forks N workers (for each N in -p) that repeatedly take the installation
+ * lock of one base_dir with acquire_lock_safe(), hold it for a random time
+ * and release it with release_lock_safe(), the way concurrent cold launches
+ * do. With probability -k a holder SIGKILLs itself mid-hold, as a launch
+ * killed during extraction would; the slot is then restarted with its
+ * remaining acquisitions.
+ *
+ * Reported per N:
+ *   acquire   time spent in acquire_lock_safe (successful calls)
+ *   handover  from one holder finishing (release or death) to the next
+ *             acquiring, which is where the 100 ms polling shows up
+ *   fairness  Jain's index over each worker's mean wait (1.0 = even)
+ *   timeouts  acquire_lock_safe calls that gave up after -t seconds
+ *   breaks    times a waiter decided to break the lock; the lock is always
+ *             held by a live process when this happens (F_SETLK just
+ *             failed), so every break is a wrong one
+ *   overlaps  times two workers held the lock at once
+ *
+ * Breaks are counted from the workers' log output, which goes to a file in
+ * the scratch directory.
+ *
+ * Usage: lock_bench [-p counts] [-n acquisitions] [-H min:max hold ms]
+ *                   [-k crash percent] [-t timeout] [-d dir] [-o results.json]
+ */
+#include "bench.h"
+#include "locking.h"
+#include "logging.h"
+#include "pathutils.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define MAX_WORKERS 64
+#define DEFAULT_COUNTS "1,2,4,8,16,32,64"
+
+struct worker_slot {
+  atomic_int remaining;  /* Acquisitions still to do */
+  atomic_uint acquired;  /* Successful acquisitions */
+  atomic_uint timeouts;  /* acquire_lock_safe failures */
+  atomic_uint crashes;   /* Injected holder deaths */
+  atomic_ullong wait_ns; /* Total time in successful acquire calls */
+};
+
+/* Shared between the parent and all workers */
+struct lock_shared {
+  atomic_int holders;            /* Workers currently inside the lock */
+  atomic_uint overlaps;          /* Acquisitions that found another holder */
+  atomic_ullong last_release_ns; /* When the last holder finished, or 0 */
+  atomic_size_t acquire_count;
+  atomic_size_t handover_count;
+  struct worker_slot slots[MAX_WORKERS];
+  /* acquire_ns and handover_ns follow, `capacity` entries each */
+};
+
+struct lock_params {
+  char lock_path[PATH_MAX];
+  char exe_path[PATH_MAX];
+  unsigned hold_min_ms;
+  unsigned hold_max_ms;
+  unsigned crash_pct;
+  int timeout;
+};
+
+struct lock_result {
+  int workers;
+  size_t acquisitions;
+  unsigned timeouts, crashes, overlaps;
+  unsigned breaks_stale, breaks_expired;
+  struct bench_stats acquire, handover;
+  double fairness;
+  double elapsed_s;
+};
+
+static uint64_t *acquire_samples(struct lock_shared *sh) {
+  return (uint64_t *)(sh + 1);
+}
+
+static uint64_t *handover_samples(struct lock_shared *sh, size_t capacity) {
+  return acquire_samples(sh) + capacity;
+}
+
+static unsigned next_rand(uint64_t *seed) {
+  *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+  return (unsigned)(*seed >> 33);
+}
+
+static void sleep_ns(uint64_t ns) {
+  struct timespec ts = {.tv_sec = (time_t)(ns / 1000000000ull),
+                        .tv_nsec = (long)(ns % 1000000000ull)};
+  while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+  }
+}
+
+static void run_worker(struct lock_shared *sh, size_t capacity, int slot_index,
+                       const struct lock_params *p) {
+  struct worker_slot *slot = &sh->slots[slot_index];
+  uint64_t seed = (uint64_t)getpid() << 16 ^ (uint64_t)bench_now_ns();
+  unsigned span = p->hold_max_ms - p->hold_min_ms + 1;
+
+  while (atomic_fetch_sub(&slot->remaining, 1) > 0) {
+    uint64_t hold_ns =
+        (uint64_t)(p->hold_min_ms + next_rand(&seed) % span) * 1000000ull;
+    int crash = next_rand(&seed) % 100 < p->crash_pct;
+
+    uint64_t start = bench_now_ns();
+    int fd = acquire_lock_safe(p->lock_path, p->exe_path, p->timeout);
+    uint64_t now = bench_now_ns();
+
+    if (fd < 0) {
+      atomic_fetch_add(&slot->timeouts, 1);
+      continue;
+    }
+    if (atomic_fetch_add(&sh->holders, 1) != 0) {
+      atomic_fetch_add(&sh->overlaps, 1);
+    }
+
+    size_t i = atomic_fetch_add(&sh->acquire_count, 1);
+    if (i < capacity) {
+      acquire_samples(sh)[i] = now - start;
+    }
+    uint64_t last = atomic_exchange(&sh->last_release_ns, 0);
+    if (last) {
+      i = atomic_fetch_add(&sh->handover_count, 1);
+      if (i < capacity) {
+        handover_samples(sh, capacity)[i] = now - last;
+      }
+    }
+    atomic_fetch_add(&slot->acquired, 1);
+    atomic_fetch_add(&slot->wait_ns, now - start);
+
+    if (crash) {
+      /* Die somewhere in the middle of the "install"; the kernel drops the
+       * lock when the process goes away */
+      sleep_ns(hold_ns * (next_rand(&seed) % 100) / 100);
+      atomic_fetch_add(&slot->crashes, 1);
+      atomic_fetch_sub(&sh->holders, 1);
+      atomic_store(&sh->last_release_ns, bench_now_ns());
+      raise(SIGKILL);
+    }
+
+    sleep_ns(hold_ns);
+    atomic_fetch_sub(&sh->holders, 1);
+    atomic_store(&sh->last_release_ns, bench_now_ns());
+    release_lock_safe(fd);
+  }
+  _exit(0);
+}
+
+static pid_t spawn_worker(struct lock_shared *sh, size_t capacity, int slot,
+                          const struct lock_params *p, int log_fd) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(log_fd, STDERR_FILENO);
+    run_worker(sh, capacity, slot, p);
+  }
+  return pid;
+}
+
+/* Count log lines containing needle */
+static unsigned count_lines(const char *path, const char *needle) {
+  FILE *f = fopen(path, "r");
+  char line[1024];
+  unsigned n = 0;
+
+  if (!f) {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), f)) {
+    n += strstr(line, needle) != NULL;
+  }
+  fclose(f);
+  return n;
+}
+
+static int run_round(int workers, size_t per_worker, const char *dir,
+                     const struct lock_params *p, struct lock_result *res) {
+  size_t capacity = (size_t)workers * per_worker;
+  size_t map_size =
+      sizeof(struct lock_shared) + 2 * capacity * sizeof(uint64_t);
+  pid_t pids[MAX_WORKERS];
+  char log_path[PATH_MAX];
+  int running = 0;
+
+  struct lock_shared *sh = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (sh == MAP_FAILED) {
+    fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  if (path_join(log_path, sizeof(log_path), dir, "workers.log", NULL) !=
+      WRP_OK) {
+    munmap(sh, map_size);
+    return -1;
+  }
+  int log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0600);
+  if (log_fd < 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", log_path, strerror(errno));
+    munmap(sh, map_size);
+    return -1;
+  }
+
+  uint64_t start = bench_now_ns();
+  for (int w = 0; w < workers; w++) {
+    atomic_store(&sh->slots[w].remaining, (int)per_worker);
+    pids[w] = spawn_worker(sh, capacity, w, p, log_fd);
+    running += pids[w] > 0;
+  }
+
+  /* Reap workers, restarting the ones that crashed while work remains */
+  while (running > 0) {
+    int wstatus;
+    pid_t pid = wait(&wstatus);
+    if (pid < 0) {
+      break;
+    }
+    running--;
+    for (int w = 0; w < workers; w++) {
+      if (pids[w] != pid) {
+        continue;
+      }
+      pids[w] = -1;
+      if (WIFSIGNALED(wstatus) && atomic_load(&sh->slots[w].remaining) > 0) {
+        pids[w] = spawn_worker(sh, capacity, w, p, log_fd);
+        running += pids[w] > 0;
+      }
+      break;
+    }
+  }
+  double elapsed = (double)(bench_now_ns() - start) / 1e9;
+  close(log_fd);
+
+  /* Aggregate */
+  double sum = 0, sum_sq = 0;
+  int active = 0;
+  memset(res, 0, sizeof(*res));
+  res->workers = workers;
+  res->elapsed_s = elapsed;
+  for (int w = 0; w < workers; w++) {
+    struct worker_slot *slot = &sh->slots[w];
+    unsigned acquired = atomic_load(&slot->acquired);
+    res->timeouts += atomic_load(&slot->timeouts);
+    res->crashes += atomic_load(&slot->crashes);
+    if (acquired) {
+      double mean = (double)atomic_load(&slot->wait_ns) / acquired;
+      sum += mean;
+      sum_sq += mean * mean;
+      active++;
+    }
+  }
+  res->fairness = sum_sq > 0 ? sum * sum / (active * sum_sq) : 1.0;
+  res->overlaps = atomic_load(&sh->overlaps);
+
+  size_t acquires = atomic_load(&sh->acquire_count);
+  size_t handovers = atomic_load(&sh->handover_count);
+  acquires = acquires < capacity ? acquires : capacity;
+  handovers = handovers < capacity ? handovers : capacity;
+  res->acquisitions = acquires;
+  res->acquire = bench_summarize(acquire_samples(sh), acquires);
+  res->handover = bench_summarize(handover_samples(sh, capacity), handovers);
+
+  res->breaks_stale = count_lines(log_path, "Breaking stale lock");
+  res->breaks_expired = count_lines(log_path, "Breaking expired lock");
+
+  munmap(sh, map_size);
+  return 0;
+}
+
+static void print_stats_json(FILE *f, const char *name,
+                             const struct bench_stats *st) {
+  fprintf(f,
+          "\"%s\": {\"count\": %zu, \"p50_us\": %.1f, \"p95_us\": %.1f, "
+          "\"p99_us\": %.1f, \"max_us\": %.1f, \"mean_us\": %.1f}",
+          name, st->runs, st->p50 / 1e3, st->p95 / 1e3, st->p99 / 1e3,
+          st->max / 1e3, st->mean / 1e3);
+}
+
+static void print_json(FILE *f, const struct lock_params *p, size_t per_worker,
+                       const struct lock_result *results, size_t count) {
+  fprintf(f,
+          "{\n  \"bench\": \"lock\",\n  \"acquisitions_per_worker\": %zu,\n"
+          "  \"hold_ms\": [%u, %u],\n  \"crash_pct\": %u,\n"
+          "  \"timeout_s\": %d,\n  \"rounds\": [",
+          per_worker, p->hold_min_ms, p->hold_max_ms, p->crash_pct,
+          p->timeout);
+  for (size_t i = 0; i < count; i++) {
+    const struct lock_result *r = &results[i];
+    fprintf(f,
+            "%s\n    {\"workers\": %d, \"acquisitions\": %zu, "
+            "\"timeouts\": %u, \"crashes\": %u, \"breaks_stale\": %u, "
+            "\"breaks_expired\": %u, \"overlaps\": %u, \"fairness\": %.3f, "
+            "\"elapsed_s\": %.2f,\n     ",
+            i ? "," : "", r->workers, r->acquisitions, r->timeouts,
+            r->crashes, r->breaks_stale, r->breaks_expired, r->overlaps,
+            r->fairness, r->elapsed_s);
+    print_stats_json(f, "acquire", &r->acquire);
+    fprintf(f, ",\n     ");
+    print_stats_json(f, "handover", &r->handover);
+    fprintf(f, "}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  struct lock_params params = {
+      .hold_min_ms = 1, .hold_max_ms = 20, .crash_pct = 5,
+      .timeout = LOCK_TIMEOUT};
+  struct lock_result results[MAX_WORKERS];
+  const char *counts = DEFAULT_COUNTS;
+  const char *dir_base = "/tmp";
+  const char *json_path = NULL;
+  size_t per_worker = 10;
+  size_t nresults = 0;
+  char dir[PATH_MAX];
+  int opt;
+
+  log_init(LOG_WARNING, 0);
+
+  while ((opt = getopt(argc, argv, "p:n:H:k:t:d:o:")) != -1) {
+    switch (opt) {
+    case 'p':
+      counts = optarg;
+      break;
+    case 'n':
+      per_worker = strtoul(optarg, NULL, 10);
+      break;
+    case 'H':
+      if (sscanf(optarg, "%u:%u", &params.hold_min_ms, &params.hold_max_ms) !=
+              2 ||
+          params.hold_max_ms < params.hold_min_ms) {
+        fprintf(stderr, "Bad hold range: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'k':
+      params.crash_pct = (unsigned)atoi(optarg);
+      break;
+    case 't':
+      params.timeout = atoi(optarg);
+      break;
+    case 'd':
+      dir_base = optarg;
+      break;
+    case 'o':
+      json_path = optarg;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-p counts] [-n acquisitions] [-H min:max] "
+              "[-k crash%%] [-t timeout] [-d dir] [-o results.json]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (per_worker == 0) {
+    fprintf(stderr, "Need at least one acquisition per worker\n");
+    return EXIT_FAILURE;
+  }
+  if (path_readlink(params.exe_path, sizeof(params.exe_path),
+                    "/proc/self/exe") != WRP_OK) {
+    return EXIT_FAILURE;
+  }
+  snprintf(dir, sizeof(dir), "%s/pyb-lock-bench.%d", dir_base, (int)getpid());
+  if (create_directory_with_parents(dir, 0700) != WRP_OK ||
+      path_get_lock_file(params.lock_path, sizeof(params.lock_path), dir) !=
+          WRP_OK) {
+    return EXIT_FAILURE;
+  }
+
+  printf("hold %u-%u ms, %u%% holder crashes, %zu acquisitions per worker, "
+         "timeout %d s\n",
+         params.hold_min_ms, params.hold_max_ms, params.crash_pct, per_worker,
+         params.timeout);
+  printf("%7s %6s %5s %5s %8s %8s %8s %8s %8s %8s %6s %6s %5s\n", "workers",
+         "acq", "tmo", "crash", "acq p50", "acq p95", "acq p99", "acq max",
+         "hand p50", "hand p95", "fair", "breaks", "ovlp");
+
+  for (const char *c = counts; *c && nresults < MAX_WORKERS;) {
+    char *end;
+    long workers = strtol(c, &end, 10);
+    if (end == c || workers < 1 || workers > MAX_WORKERS) {
+      fprintf(stderr, "Worker counts must be 1-%d: %s\n", MAX_WORKERS,
+              counts);
+      remove_directory_recursive(dir);
+      return EXIT_FAILURE;
+    }
+    c = *end == ',' ? end + 1 : end;
+
+    struct lock_result *r = &results[nresults];
+    if (run_round((int)workers, per_worker, dir, &params, r) != 0) {
+      remove_directory_recursive(dir);
+      return EXIT_FAILURE;
+    }
+    nresults++;
+
+    printf("%7d %6zu %5u %5u %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %6.3f %6u "
+           "%5u\n",
+           r->workers, r->acquisitions, r->timeouts, r->crashes,
+           r->acquire.p50 / 1e6, r->acquire.p95 / 1e6, r->acquire.p99 / 1e6,
+           r->acquire.max / 1e6, r->handover.p50 / 1e6,
+           r->handover.p95 / 1e6, r->fairness,
+           r->breaks_stale + r->breaks_expired, r->overlaps);
+  }
+  printf("(times in ms)\n");
+
+  remove_directory_recursive(dir);
+
+  FILE *json = bench_json_open(json_path);
+  if (json) {
+    print_json(json, &params, per_worker, results, nresults);
+    fclose(json);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+/* Archive entry name scanner: cross-check and throughput
+ *
+ * Every kernel is first checked against the scalar kernel and against the
+ * pathutils.c helpers it replaces on the extraction path, then timed over the
+ * corpus. A corpus file (one entry name per line, e.g. `bsdtar -tf` of the
+ * payload) can be given with -c; otherwise bench_stdlib_corpus() is used.
+ */
+#include "bench.h"
+#include "logging.h"
+#include "pathscan.h"
+#include "pathutils.h"
+
+#define TARGET_DIR "/tmp/pyb-bench/.tmp"
+#define FUZZ_NAMES 200000
+
+static const char *kernel_names[] = {"scalar", "sse2", "avx2"};
+#define KERNEL_COUNT (sizeof(kernel_names) / sizeof(kernel_names[0]))
+
+static const char *sections[] = {SECTION_PYTHON, SECTION_APP};
+
+/* Names that exercise every finding and the 16/32/64-byte block edges */
+static const char *edge_names[] = {
+    "./python/",
+    "./python",
+    "./pythonx/lib",
+    "./apps/umu-run/bin/umu-run",
+    "./python/./lib",
+    "./python/../../etc/passwd",
+    "./python/lib/..",
+    "./python/lib/.",
+    "./python/lib/...",
+    "./python/lib/..hidden",
+    "./python/lib/.hidden",
+    "./python//lib",
+    "./python/lib//",
+    "/python/lib",
+    "//python/lib",
+    "python/lib/os.py",
+    "./python/lib/\x01ctrl",
+    "./python/lib/del\x7f",
+    "./python/lib/python3.13/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/..",
+    "./python/lib/python3.13/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/./x",
+    "./python/lib/python3.13/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa//x",
+    "./python/lib/python3.13/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa/..",
+    "./.",
+    "./..",
+    ".",
+    "..",
+    "",
+    NULL};
+
+/* Deterministic xorshift so failures are reproducible */
+static uint64_t fuzz_state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t fuzz_next(void) {
+  fuzz_state ^= fuzz_state << 13;
+  fuzz_state ^= fuzz_state >> 7;
+  fuzz_state ^= fuzz_state << 17;
+  return fuzz_state;
+}
+
+static size_t fuzz_name(char *buf, size_t size) {
+  static const char alphabet[] = {'a', 'b', '.', '.', '/', '/', '\0', '\x1f',
+                                  '\x7f', 'p'};
+  size_t len = fuzz_next() % (size < 300 ? size : 300);
+
+  if (fuzz_next() % 4 == 0 && len >= 2) {
+    buf[0] = '.';
+    buf[1] = '/';
+    for (size_t i = 2; i < len; i++) {
+      buf[i] = alphabet[fuzz_next() % sizeof(alphabet)];
+    }
+  } else {
+    for (size_t i = 0; i < len; i++) {
+      buf[i] = alphabet[fuzz_next() % sizeof(alphabet)];
+    }
+  }
+  return len;
+}
+
+/* The extraction path the fast route in archive.c builds */
+static void fast_path(const char *name, const struct path_scan *scan,
+                      char *dest) {
+  size_t rel_len = scan->length - scan->rel_offset;
+  if (rel_len > 0 && name[scan->rel_offset + rel_len - 1] == '/') {
+    rel_len--;
+  }
+  snprintf(dest, PATH_MAX, "%s/%.*s", TARGET_DIR, (int)rel_len,
+           name + scan->rel_offset);
+}
+
+/* The sequence archive.c ran per entry before the scanner */
+static int legacy_path(const char *name, const char *section, char *dest) {
+  char rel[PATH_MAX];
+  char full[PATH_MAX];
+  int is_subpath;
+
+  if (path_is_subpath(section, name, &is_subpath) != WRP_OK || !is_subpath) {
+    return 0;
+  }
+  if (path_strip_archive_prefix(rel, sizeof(rel), name, section) != WRP_OK ||
+      path_join(full, sizeof(full), TARGET_DIR, rel, NULL) != WRP_OK) {
+    return -1;
+  }
+  strcpy(dest, full);
+  if (path_normalize(dest, PATH_MAX) != WRP_OK ||
+      path_is_subpath(TARGET_DIR, dest, &is_subpath) != WRP_OK ||
+      !is_subpath) {
+    return -1;
+  }
+  return 1;
+}
+
+static int check_name(const char *name, size_t len, int with_pathutils) {
+  struct path_scan ref, scan;
+  int failures = 0;
+
+  for (size_t s = 0; s < sizeof(sections) / sizeof(sections[0]); s++) {
+    path_scan_select("scalar");
+    path_scan_entry(name, len, sections[s], &ref);
+
+    for (size_t k = 1; k < KERNEL_COUNT; k++) {
+      if (path_scan_select(kernel_names[k]) != WRP_OK) {
+        continue;
+      }
+      path_scan_entry(name, len, sections[s], &scan);
+      if (scan.flags != ref.flags || scan.rel_offset != ref.rel_offset) {
+        fprintf(stderr, "MISMATCH %s vs scalar on '%.*s': %#x != %#x\n",
+                kernel_names[k], (int)len, name, scan.flags, ref.flags);
+        failures++;
+      }
+    }
+
+    if (!with_pathutils || len == 0) {
+      continue;
+    }
+
+    /* Dot components are exactly what path_is_safe rejects */
+    int safe = path_is_safe(name + ref.rel_offset) == WRP_OK;
+    int scan_safe = !(ref.flags & (SCAN_DOT | SCAN_DOTDOT));
+    if (ref.rel_offset < len && safe != scan_safe) {
+      fprintf(stderr, "MISMATCH path_is_safe on '%s': %d != %d\n", name, safe,
+              scan_safe);
+      failures++;
+    }
+
+    /* Names the pathutils sequence rejects must not take the fast route */
+    char legacy[PATH_MAX], fast[PATH_MAX];
+    int legacy_in = legacy_path(name, sections[s], legacy);
+    int slow = (ref.flags & (SCAN_NEEDS_SLOWPATH | SCAN_UNSAFE)) != 0;
+    if (legacy_in < 0 && !slow) {
+      fprintf(stderr, "MISMATCH fast route for rejected '%s' in %s: %#x\n",
+              name, sections[s], ref.flags);
+      failures++;
+    }
+
+    /* Names on the fast route must resolve like the pathutils sequence */
+    if (slow || legacy_in < 0) {
+      continue;
+    }
+    int fast_in = !(ref.flags & SCAN_OUTSIDE);
+    if (legacy_in != fast_in) {
+      fprintf(stderr, "MISMATCH section %s on '%s': %d != %d\n", sections[s],
+              name, fast_in, legacy_in);
+      failures++;
+    } else if (fast_in) {
+      fast_path(name, &ref, fast);
+      if (strcmp(fast, legacy) != 0) {
+        fprintf(stderr, "MISMATCH path on '%s': '%s' != '%s'\n", name, fast,
+                legacy);
+        failures++;
+      }
+    }
+  }
+  return failures;
+}
+
+/* Print one timing row, and add it to the JSON results if requested */
+static void report_kernel(FILE *json, const char *name, uint64_t elapsed,
+                          size_t count, size_t bytes, int rounds, int first) {
+  double ns = (double)elapsed / ((double)count * rounds);
+  double mbs = (double)bytes * rounds / ((double)elapsed / 1e9) / 1e6;
+
+  printf("%-8s %12.1f %12.1f\n", name, ns, mbs);
+  if (json) {
+    fprintf(json, "%s\n    \"%s\": {\"ns_per_name\": %.1f, \"mb_s\": %.1f}",
+            first ? "" : ",", name, ns, mbs);
+  }
+}
+
+static void time_kernels(char **names, size_t count, int rounds) {
+  FILE *json = bench_json_open(NULL);
+  struct path_scan scan;
+  size_t bytes = 0;
+  size_t *lens = malloc(count * sizeof(size_t));
+
+  for (size_t i = 0; i < count; i++) {
+    lens[i] = strlen(names[i]);
+    bytes += lens[i];
+  }
+
+  printf("%-8s %12s %12s\n", "kernel", "ns/name", "MB/s");
+  if (json) {
+    fprintf(json,
+            "{\n  \"bench\": \"pathscan\",\n  \"names\": %zu,\n"
+            "  \"rounds\": %d,\n  \"default_kernel\": \"%s\",\n"
+            "  \"kernels\": {",
+            count, rounds, path_scan_impl());
+  }
+  for (size_t k = 0; k < KERNEL_COUNT; k++) {
+    if (path_scan_select(kernel_names[k]) != WRP_OK) {
+      printf("%-8s %12s\n", kernel_names[k], "unsupported");
+      continue;
+    }
+    uint64_t acc = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < rounds; r++) {
+      for (size_t i = 0; i < count; i++) {
+        path_scan_entry(names[i], lens[i], SECTION_PYTHON, &scan);
+        acc += scan.flags + scan.rel_offset;
+      }
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    bench_consume(acc);
+    report_kernel(json, kernel_names[k], elapsed, count, bytes, rounds,
+                  k == 0);
+  }
+
+  /* What archive.c did per entry before: subpath, strip, join, normalize,
+   * subpath again */
+  char dest[PATH_MAX];
+  uint64_t acc = 0;
+  uint64_t start = bench_now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < count; i++) {
+      acc += (uint64_t)legacy_path(names[i], SECTION_PYTHON, dest);
+    }
+  }
+  uint64_t elapsed = bench_now_ns() - start;
+  bench_consume(acc);
+  report_kernel(json, "legacy", elapsed, count, bytes, rounds, 0);
+
+  if (json) {
+    fprintf(json, "\n  }\n}\n");
+    fclose(json);
+  }
+
+  free(lens);
+}
+
+int main(int argc, char *argv[]) {
+  char **corpus = NULL;
+  size_t count = 0;
+  int rounds = 200;
+  int failures = 0;
+  int opt;
+
+  log_init(LOG_INFO, 0);
+
+  while ((opt = getopt(argc, argv, "c:r:")) != -1) {
+    switch (opt) {
+    case 'c': {
+      long n = bench_read_lines(optarg, &corpus);
+      if (n <= 0) {
+        fprintf(stderr, "Failed to read corpus: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      count = (size_t)n;
+      break;
+    }
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-c corpus] [-r rounds]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!corpus && !(corpus = bench_stdlib_corpus(&count))) {
+    return EXIT_FAILURE;
+  }
+
+  /* Cross-check */
+  for (const char **name = edge_names; *name; name++) {
+    failures += check_name(*name, strlen(*name), 1);
+  }
+  for (size_t i = 0; i < count; i++) {
+    failures += check_name(corpus[i], strlen(corpus[i]), 1);
+  }
+
+  char buf[PATH_MAX];
+  for (int i = 0; i < FUZZ_NAMES; i++) {
+    size_t len = fuzz_name(buf, sizeof(buf) - 1);
+    buf[len] = '\0';
+    failures += check_name(buf, len, memchr(buf, '\0', len) == NULL);
+  }
+
+  if (failures) {
+    fprintf(stderr, "%d mismatches\n", failures);
+    return EXIT_FAILURE;
+  }
+  printf("Cross-check passed: %zu corpus names, %d fuzzed names\n", count,
+         FUZZ_NAMES);
+
+  /* Throughput */
+  time_kernels(corpus, count, rounds);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,380 @@
+/* pathutils.c microbenchmarks: ns/op and allocations/op
+ *
+ * Times the helpers the extraction and install paths call per entry over four
+ * corpora: real entry names (a listing given with -c, which `make bench`
+ * fills with `bsdtar -tf` of the payload, else bench_stdlib_corpus()), short
+ * names, deep names close to PATH_MAX, and pathological names (dot
+ * components, repeated and trailing slashes, long components). Meant as the
+ * baseline to compare against before and after changing pathutils.c.
+ *
+ * Allocations are counted by wrapping the allocator at link time; the
+ * Makefile links this bench with -Wl,--wrap for each function below.
+ */
+#include "bench.h"
+#include "logging.h"
+#include "pathutils.h"
+
+#define TARGET_DIR "/tmp/pyb-bench/.tmp"
+#define DEFAULT_MIN_OPS 200000
+
+/* Allocation counting */
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t n);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+char *__wrap_strdup(const char *s);
+char *__wrap_strndup(const char *s, size_t n);
+
+static uint64_t alloc_count;
+
+/* Set while inside a wrapped strdup, so the malloc it makes (when libc's
+ * strdup is itself wrapped) is not counted twice */
+static int alloc_nested;
+
+void *__wrap_malloc(size_t size) {
+  alloc_count += !alloc_nested;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+  alloc_count += !alloc_nested;
+  return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  alloc_count += !alloc_nested;
+  return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+  alloc_count += !alloc_nested;
+  alloc_nested++;
+  char *copy = __real_strdup(s);
+  alloc_nested--;
+  return copy;
+}
+
+char *__wrap_strndup(const char *s, size_t n) {
+  alloc_count += !alloc_nested;
+  alloc_nested++;
+  char *copy = __real_strndup(s, n);
+  alloc_nested--;
+  return copy;
+}
+
+/* Corpora */
+
+struct corpus {
+  const char *name;
+  char **paths;
+  size_t *lens;
+  size_t count;
+};
+
+static const char *pathological_names[] = {
+    "",
+    ".",
+    "..",
+    "/",
+    "//",
+    "./",
+    "./python",
+    "./python/",
+    "./python//lib//python3.13///os.py",
+    "./python/lib/python3.13/",
+    "./python/lib/python3.13////",
+    "./python/./lib/./python3.13/./os.py",
+    "./python/../../etc/passwd",
+    "./python/lib/../lib/../lib/os.py",
+    "./python/lib/...",
+    "./python/lib/..hidden",
+    "./pythonx/lib/os.py",
+    "./apps/umu-run/bin/umu-run",
+    "python/lib/os.py",
+    "/python/lib/os.py",
+    "////////////////////////////////////////////////////////////////",
+    "./././././././././././././././././././././././././././././././.",
+    NULL};
+
+static const char *short_names[] = {
+    "./python/bin",   "./python/lib", "./apps/",  "./python/a",
+    "./python/a/b",   "./python/x.py", "./apps/a", "./python/include",
+    NULL};
+
+static int corpus_add(struct corpus *c, size_t *alloc, const char *path) {
+  if (c->count + 1 >= *alloc) {
+    size_t grown = *alloc ? *alloc * 2 : 64;
+    char **paths = realloc(c->paths, grown * sizeof(*paths));
+    if (!paths) {
+      return -1;
+    }
+    c->paths = paths;
+    *alloc = grown;
+  }
+  if (!(c->paths[c->count] = strdup(path))) {
+    return -1;
+  }
+  c->paths[++c->count] = NULL;
+  return 0;
+}
+
+static int corpus_from_list(struct corpus *c, const char **names) {
+  size_t alloc = 0;
+  for (const char **name = names; *name; name++) {
+    if (corpus_add(c, &alloc, *name) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Deep names: many short components, and a few long ones, ending close to
+ * PATH_MAX once joined onto TARGET_DIR */
+static int corpus_deep(struct corpus *c) {
+  size_t limit = PATH_MAX - sizeof(TARGET_DIR) - 16;
+  size_t alloc = 0;
+  char buf[PATH_MAX];
+
+  for (size_t width = 1; width <= 64; width *= 4) {
+    size_t len = (size_t)snprintf(buf, sizeof(buf), "./python");
+    for (int depth = 0; len + width + 1 < limit; depth++) {
+      buf[len++] = '/';
+      for (size_t i = 0; i < width; i++) {
+        buf[len++] = (char)('a' + (depth + (int)i) % 26);
+      }
+      buf[len] = '\0';
+      /* Also keep a few intermediate depths */
+      if (depth == 8 || depth == 64) {
+        if (corpus_add(c, &alloc, buf) != 0) {
+          return -1;
+        }
+      }
+    }
+    if (corpus_add(c, &alloc, buf) != 0) {
+      return -1;
+    }
+  }
+
+  /* A single maximal component (NAME_MAX) */
+  memcpy(buf, "./python/", 9);
+  memset(buf + 9, 'n', NAME_MAX);
+  buf[9 + NAME_MAX] = '\0';
+  return corpus_add(c, &alloc, buf);
+}
+
+static int corpus_finish(struct corpus *c) {
+  if (!c->paths || !(c->lens = malloc(c->count * sizeof(size_t)))) {
+    return -1;
+  }
+  for (size_t i = 0; i < c->count; i++) {
+    c->lens[i] = strlen(c->paths[i]);
+  }
+  return 0;
+}
+
+/* Operations */
+
+struct operation {
+  const char *name;
+  uint64_t (*run)(const struct corpus *c, size_t reps);
+};
+
+static uint64_t run_join(const struct corpus *c, size_t reps) {
+  char dest[PATH_MAX];
+  uint64_t acc = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      acc += (uint64_t)path_join(dest, sizeof(dest), TARGET_DIR, c->paths[i],
+                                 NULL);
+      acc += (unsigned char)dest[0];
+    }
+  }
+  return acc;
+}
+
+/* path_normalize works in place, so each call starts from a fresh copy; the
+ * "copy" row measures that part alone */
+static uint64_t run_copy(const struct corpus *c, size_t reps) {
+  char buf[PATH_MAX];
+  uint64_t acc = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      memcpy(buf, c->paths[i], c->lens[i] + 1);
+      bench_consume((uint64_t)(uintptr_t)buf);
+      acc += (unsigned char)buf[0];
+    }
+  }
+  return acc;
+}
+
+static uint64_t run_normalize(const struct corpus *c, size_t reps) {
+  char buf[PATH_MAX];
+  uint64_t acc = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      memcpy(buf, c->paths[i], c->lens[i] + 1);
+      acc += (uint64_t)path_normalize(buf, sizeof(buf));
+      acc += (unsigned char)buf[0];
+    }
+  }
+  return acc;
+}
+
+static uint64_t run_is_subpath(const struct corpus *c, size_t reps) {
+  uint64_t acc = 0;
+  int is_subpath = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      acc += (uint64_t)path_is_subpath(SECTION_PYTHON, c->paths[i],
+                                       &is_subpath);
+      acc += (uint64_t)is_subpath;
+    }
+  }
+  return acc;
+}
+
+static uint64_t run_strip_prefix(const struct corpus *c, size_t reps) {
+  char dest[PATH_MAX];
+  uint64_t acc = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      acc += (uint64_t)path_strip_archive_prefix(dest, sizeof(dest),
+                                                 c->paths[i], SECTION_PYTHON);
+    }
+  }
+  return acc;
+}
+
+static uint64_t run_is_safe(const struct corpus *c, size_t reps) {
+  uint64_t acc = 0;
+  for (size_t r = 0; r < reps; r++) {
+    for (size_t i = 0; i < c->count; i++) {
+      acc += (uint64_t)path_is_safe(c->paths[i]);
+    }
+  }
+  return acc;
+}
+
+static const struct operation operations[] = {
+    {"path_join", run_join},
+    {"copy", run_copy},
+    {"path_normalize", run_normalize},
+    {"path_is_subpath", run_is_subpath},
+    {"path_strip_archive_prefix", run_strip_prefix},
+    {"path_is_safe", run_is_safe}};
+
+#define OPERATION_COUNT (sizeof(operations) / sizeof(operations[0]))
+
+int main(int argc, char *argv[]) {
+  struct corpus corpora[] = {
+      {.name = "real"}, {.name = "short"}, {.name = "deep"},
+      {.name = "pathological"}};
+  size_t ncorpora = sizeof(corpora) / sizeof(corpora[0]);
+  size_t min_ops = DEFAULT_MIN_OPS;
+  const char *json_path = NULL;
+  int opt;
+
+  /* Keep log_debug formatting out of the timings */
+  log_init(LOG_WARNING, 0);
+
+  while ((opt = getopt(argc, argv, "c:n:o:")) != -1) {
+    switch (opt) {
+    case 'c': {
+      long n = bench_read_lines(optarg, &corpora[0].paths);
+      if (n <= 0) {
+        fprintf(stderr, "Failed to read corpus: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      corpora[0].count = (size_t)n;
+      break;
+    }
+    case 'n':
+      min_ops = strtoul(optarg, NULL, 10);
+      break;
+    case 'o':
+      json_path = optarg;
+      break;
+    default:
+      fprintf(stderr, "Usage: %s [-c corpus] [-n min_ops] [-o results.json]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!corpora[0].paths &&
+      !(corpora[0].paths = bench_stdlib_corpus(&corpora[0].count))) {
+    return EXIT_FAILURE;
+  }
+  if (corpus_from_list(&corpora[1], short_names) != 0 ||
+      corpus_deep(&corpora[2]) != 0 ||
+      corpus_from_list(&corpora[3], pathological_names) != 0) {
+    fprintf(stderr, "Failed to build corpora\n");
+    return EXIT_FAILURE;
+  }
+  for (size_t k = 0; k < ncorpora; k++) {
+    if (corpus_finish(&corpora[k]) != 0) {
+      fprintf(stderr, "Failed to build corpora\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  FILE *json = bench_json_open(json_path);
+  if (json) {
+    fprintf(json, "{\n  \"bench\": \"pathutils\",\n  \"corpora\": {");
+    for (size_t k = 0; k < ncorpora; k++) {
+      fprintf(json, "%s\"%s\": %zu", k ? ", " : "", corpora[k].name,
+              corpora[k].count);
+    }
+    fprintf(json, "},\n  \"results\": {");
+  }
+
+  printf("%-26s %-13s %8s %10s %10s\n", "function", "corpus", "names",
+         "ns/op", "allocs/op");
+  for (size_t o = 0; o < OPERATION_COUNT; o++) {
+    const struct operation *op = &operations[o];
+
+    if (json) {
+      fprintf(json, "%s\n    \"%s\": {", o ? "," : "", op->name);
+    }
+    for (size_t k = 0; k < ncorpora; k++) {
+      const struct corpus *c = &corpora[k];
+      size_t reps = min_ops / c->count + 1;
+      double ops = (double)reps * (double)c->count;
+
+      /* One untimed pass to warm the caches */
+      bench_consume(op->run(c, 1));
+
+      uint64_t allocs = alloc_count;
+      uint64_t start = bench_now_ns();
+      bench_consume(op->run(c, reps));
+      uint64_t elapsed = bench_now_ns() - start;
+      allocs = alloc_count - allocs;
+
+      double ns = (double)elapsed / ops;
+      double per_op = (double)allocs / ops;
+      printf("%-26s %-13s %8zu %10.1f %10.2f\n", op->name, c->name, c->count,
+             ns, per_op);
+      if (json) {
+        fprintf(json,
+                "%s\n      \"%s\": {\"ns_per_op\": %.1f, "
+                "\"allocs_per_op\": %.2f}",
+                k ? "," : "", c->name, ns, per_op);
+      }
+    }
+    if (json) {
+      fprintf(json, "\n    }");
+    }
+  }
+
+  if (json) {
+    fprintf(json, "\n  }\n}\n");
+    fclose(json);
+  }
+  return EXIT_SUCCESS;
+}
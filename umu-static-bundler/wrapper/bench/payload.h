@@ -0,0 +1,437 @@
+#ifndef WRAPPER_BENCH_PAYLOAD_H
+#define WRAPPER_BENCH_PAYLOAD_H
+
+/* Synthetic payload generator shared by the benchmarks
+ *
+ * Produces the same layout docker-build.sh packs (./python/ with bin,
+ * include and lib/pythonX.Y, then ./apps/<name>/) with deterministic
+ * content, and can append it to a wrapper to form a runnable bundle:
+ * wrapper | compressed tar | %020d archive size.
+ */
+#include "bench.h"
+#include "wrapper_config.h"
+
+/* How the module tree is sized */
+typedef enum {
+  PAYLOAD_STDLIB, /* Many 1-16 KiB modules, one in ten up to 64 KiB */
+  PAYLOAD_SO,     /* A handful of 2-16 MiB shared objects */
+  PAYLOAD_MIXED   /* Both */
+} payload_dist_t;
+
+struct payload_spec {
+  size_t files;           /* Modules for PAYLOAD_STDLIB/MIXED */
+  payload_dist_t dist;    /* Size distribution */
+  const char *codec;      /* libarchive filter name, e.g. "zstd" */
+  int level;              /* Compression level, or -1 for the default */
+  const char *frames;     /* zstd: NULL, "per-file" or "max=<bytes>" */
+  const void *python_bin; /* Contents of python/bin/python */
+  size_t python_bin_size; /* Size of python_bin */
+  const void *version;    /* Contents of the app version file, or NULL */
+  size_t version_size;    /* Size of version */
+};
+
+struct payload_info {
+  size_t entries;          /* Archive entries written */
+  unsigned long long raw;  /* Uncompressed file data bytes */
+  long long archive_bytes; /* Compressed archive size */
+  long long bundle_bytes;  /* Wrapper + archive + footer */
+};
+
+/* Number of large objects in PAYLOAD_SO/MIXED */
+#define PAYLOAD_SO_FILES 6
+
+/* Read a whole file into a malloc'd buffer */
+static inline char *payload_read_file(const char *path, size_t *size) {
+  FILE *f = fopen(path, "rb");
+  char *data = NULL;
+  long len;
+
+  if (!f) {
+    return NULL;
+  }
+  if (fseek(f, 0, SEEK_END) == 0 && (len = ftell(f)) >= 0 &&
+      fseek(f, 0, SEEK_SET) == 0 && (data = malloc((size_t)len + 1))) {
+    if (fread(data, 1, (size_t)len, f) != (size_t)len) {
+      free(data);
+      data = NULL;
+    } else {
+      *size = (size_t)len;
+    }
+  }
+  fclose(f);
+  return data;
+}
+
+static inline int payload_add_entry(struct archive *aw,
+                                    struct payload_info *info,
+                                    const char *name, mode_t type, mode_t perm,
+                                    const void *data, size_t size,
+                                    const char *link) {
+  struct archive_entry *entry = archive_entry_new();
+  int r;
+
+  archive_entry_set_pathname(entry, name);
+  archive_entry_set_filetype(entry, type);
+  archive_entry_set_perm(entry, perm);
+  archive_entry_set_size(entry, type == AE_IFREG ? (la_int64_t)size : 0);
+  if (link) {
+    archive_entry_set_symlink(entry, link);
+  }
+
+  r = archive_write_header(aw, entry);
+  if (r == ARCHIVE_OK && type == AE_IFREG && size > 0) {
+    r = archive_write_data(aw, data, size) == (la_ssize_t)size ? ARCHIVE_OK
+                                                               : ARCHIVE_FATAL;
+  }
+  archive_entry_free(entry);
+  if (r != ARCHIVE_OK) {
+    fprintf(stderr, "Failed to add %s: %s\n", name, archive_error_string(aw));
+    return -1;
+  }
+
+  info->entries++;
+  if (type == AE_IFREG) {
+    info->raw += size;
+  }
+  return 0;
+}
+
+static inline int payload_add_dir(struct archive *aw,
+                                  struct payload_info *info,
+                                  const char *name) {
+  return payload_add_entry(aw, info, name, AE_IFDIR, 0755, NULL, 0, NULL);
+}
+
+/* 64-bit LCG; only the high bits are returned, the low ones have short
+ * periods */
+static inline unsigned payload_rand(uint64_t *seed) {
+  *seed = *seed * 6364136223846793005ull + 1442695040888963407ull;
+  return (unsigned)(*seed >> 33);
+}
+
+/* Fill buf with random picks from a small vocabulary, which compresses
+ * roughly like Python source. Every file gets fresh content so the
+ * compressor cannot simply reference an earlier one. */
+static inline void payload_fill_source(char *buf, size_t size,
+                                       uint64_t *seed) {
+  static const char *const words[] = {
+      "def ",    "return ", "self",   ".",       "(",     ")",     ":\n    ",
+      "import ", "if ",     "else",   " = ",     "None",  "value", "name",
+      ", ",      "for ",    " in ",   "_cache",  "\n",    "args",  "[0]",
+      "raise ",  "Error",   "class ", "kwargs",  "len(",  "not ",  "path",
+      "# ",      "\"\"\"",  "try:",   "except ", "lambda", "yield ", "data"};
+  size_t pos = 0;
+
+  while (pos < size) {
+    unsigned r = payload_rand(seed);
+    const char *w = words[(r >> 8) % (sizeof(words) / sizeof(*words))];
+    while (*w && pos < size) {
+      buf[pos++] = *w++;
+    }
+    /* Identifiers with numbers keep the match lengths short */
+    if (pos + 4 < size && (r & 7) == 0) {
+      pos += (size_t)snprintf(buf + pos, 5, "%u", r % 1000);
+    }
+  }
+}
+
+/* Fill buf with machine-code-like data: zero padding, low-entropy runs and
+ * incompressible stretches, 4 KiB at a time */
+static inline void payload_fill_binary(unsigned char *buf, size_t size,
+                                       uint64_t *seed) {
+  for (size_t off = 0; off < size; off += 4096) {
+    size_t len = size - off < 4096 ? size - off : 4096;
+    unsigned kind = payload_rand(seed) % 10;
+
+    for (size_t i = 0; i < len; i++) {
+      unsigned r = payload_rand(seed);
+      buf[off + i] = kind < 3   ? 0
+                     : kind < 7 ? (unsigned char)(0x40 + (r & 0x0f))
+                                : (unsigned char)r;
+    }
+  }
+}
+
+/* Apply codec, level and frame layout to a new writer */
+static inline int payload_set_filter(struct archive *aw,
+                                     const struct payload_spec *spec) {
+  char value[32];
+
+  int r = strcmp(spec->codec, "none") == 0
+              ? archive_write_add_filter_none(aw)
+              : archive_write_add_filter_by_name(aw, spec->codec);
+  if (r != ARCHIVE_OK) {
+    fprintf(stderr, "Unsupported codec %s: %s\n", spec->codec,
+            archive_error_string(aw));
+    return -1;
+  }
+
+  if (spec->level >= 0) {
+    snprintf(value, sizeof(value), "%d", spec->level);
+    if (archive_write_set_filter_option(aw, NULL, "compression-level",
+                                        value) != ARCHIVE_OK) {
+      fprintf(stderr, "Bad level %d for %s\n", spec->level, spec->codec);
+      return -1;
+    }
+  }
+
+  if (spec->frames && *spec->frames) {
+    if (strcmp(spec->frames, "per-file") == 0) {
+      r = archive_write_set_filter_option(aw, "zstd", "frame-per-file", "1");
+    } else if (strncmp(spec->frames, "max=", 4) == 0) {
+      r = archive_write_set_filter_option(aw, "zstd", "max-frame-in",
+                                          spec->frames + 4);
+    } else {
+      r = ARCHIVE_FAILED;
+    }
+    if (r != ARCHIVE_OK) {
+      fprintf(stderr, "Unsupported frame layout %s for %s\n", spec->frames,
+              spec->codec);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static inline int payload_add_modules(struct archive *aw,
+                                      struct payload_info *info,
+                                      const struct payload_spec *spec,
+                                      const char *pyver, uint64_t *seed) {
+  char name[PATH_MAX];
+  char *text = malloc(64 * 1024);
+  int rc = 0;
+
+  if (!text) {
+    return -1;
+  }
+  for (size_t i = 0; i < spec->files && rc == 0; i++) {
+    if (i % 50 == 0) {
+      snprintf(name, sizeof(name), "./python/lib/python%s/pkg%zu/", pyver,
+               i / 50);
+      rc = payload_add_dir(aw, info, name);
+    }
+    unsigned r = payload_rand(seed);
+    size_t size = r % 10 == 0 ? 16384 + r % 49152 : 1024 + r % 15360;
+    payload_fill_source(text, size, seed);
+    snprintf(name, sizeof(name), "./python/lib/python%s/pkg%zu/mod%zu.py",
+             pyver, i / 50, i);
+    rc = rc ? rc
+            : payload_add_entry(aw, info, name, AE_IFREG, 0644, text, size,
+                                NULL);
+  }
+  free(text);
+  return rc;
+}
+
+static inline int payload_add_objects(struct archive *aw,
+                                      struct payload_info *info,
+                                      const char *pyver, uint64_t *seed) {
+  char name[PATH_MAX];
+  size_t max = 16u << 20;
+  unsigned char *data = malloc(max);
+  int rc = 0;
+
+  if (!data) {
+    return -1;
+  }
+  snprintf(name, sizeof(name), "./python/lib/python%s/lib-dynload/", pyver);
+  rc = payload_add_dir(aw, info, name);
+  for (int i = 0; i < PAYLOAD_SO_FILES && rc == 0; i++) {
+    size_t size = (2u << 20) + payload_rand(seed) % (max - (2u << 20));
+    payload_fill_binary(data, size, seed);
+    snprintf(name, sizeof(name),
+             "./python/lib/python%s/lib-dynload/_ext%d.so", pyver, i);
+    rc = payload_add_entry(aw, info, name, AE_IFREG, 0755, data, size, NULL);
+  }
+  free(data);
+  return rc;
+}
+
+/* Write the payload archive described by spec to path */
+static inline int payload_write_archive(const char *path,
+                                        const struct payload_spec *spec,
+                                        struct payload_info *info) {
+  static const char app_script[] = "#!/bin/sh\nexit 0\n";
+  char name[PATH_MAX];
+  char pyver[16];
+  uint64_t seed = 12345;
+  int rc = -1;
+
+  memset(info, 0, sizeof(*info));
+
+  /* lib/pythonX.Y from the configured Python version */
+  const char *dot = strchr(PYTHON_VERSION, '.');
+  dot = dot ? strchr(dot + 1, '.') : NULL;
+  snprintf(pyver, sizeof(pyver), "%.*s",
+           dot ? (int)(dot - PYTHON_VERSION) : (int)strlen(PYTHON_VERSION),
+           PYTHON_VERSION);
+
+  struct archive *aw = archive_write_new();
+  archive_write_set_format_pax_restricted(aw);
+  if (payload_set_filter(aw, spec) != 0) {
+    goto out;
+  }
+  if (archive_write_open_filename(aw, path) != ARCHIVE_OK) {
+    fprintf(stderr, "Failed to create %s: %s\n", path,
+            archive_error_string(aw));
+    goto out;
+  }
+
+  snprintf(name, sizeof(name), "./python/lib/python%s/", pyver);
+  if (payload_add_dir(aw, info, "./python/") ||
+      payload_add_dir(aw, info, "./python/bin/") ||
+      payload_add_dir(aw, info, "./python/include/") ||
+      payload_add_dir(aw, info, "./python/lib/") ||
+      payload_add_dir(aw, info, name) ||
+      payload_add_entry(aw, info, "./python/bin/python", AE_IFREG, 0755,
+                        spec->python_bin, spec->python_bin_size, NULL) ||
+      payload_add_entry(aw, info, "./python/bin/python3", AE_IFLNK, 0777, NULL,
+                        0, "python")) {
+    goto out;
+  }
+
+  if (spec->dist != PAYLOAD_SO &&
+      payload_add_modules(aw, info, spec, pyver, &seed) != 0) {
+    goto out;
+  }
+  if (spec->dist != PAYLOAD_STDLIB &&
+      payload_add_objects(aw, info, pyver, &seed) != 0) {
+    goto out;
+  }
+
+  if (payload_add_dir(aw, info, "./apps/")) {
+    goto out;
+  }
+  snprintf(name, sizeof(name), "./apps/%s/", BINARY_NAME);
+  if (payload_add_dir(aw, info, name)) {
+    goto out;
+  }
+  snprintf(name, sizeof(name), "./apps/%s/bin/", BINARY_NAME);
+  if (payload_add_dir(aw, info, name)) {
+    goto out;
+  }
+  snprintf(name, sizeof(name), "./apps/%s/bin/%s", BINARY_NAME, BINARY_NAME);
+  if (payload_add_entry(aw, info, name, AE_IFREG, 0755, app_script,
+                        sizeof(app_script) - 1, NULL)) {
+    goto out;
+  }
+  if (spec->version) {
+    snprintf(name, sizeof(name), "./apps/%s/%s", BINARY_NAME, VERSION_FILE);
+    if (payload_add_entry(aw, info, name, AE_IFREG, 0644, spec->version,
+                          spec->version_size, NULL)) {
+      goto out;
+    }
+  }
+
+  rc = archive_write_close(aw) == ARCHIVE_OK ? 0 : -1;
+
+out:
+  archive_write_free(aw);
+  return rc;
+}
+
+static inline int payload_append_file(FILE *out, const char *path,
+                                      long long *size) {
+  char buf[BUFFER_SIZE * 16];
+  FILE *in = fopen(path, "rb");
+  size_t n;
+
+  if (!in) {
+    fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  *size = 0;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    if (fwrite(buf, 1, n, out) != n) {
+      fclose(in);
+      return -1;
+    }
+    *size += (long long)n;
+  }
+  fclose(in);
+  return 0;
+}
+
+/* Write wrapper | archive | %020d archive size to bundle, as build.sh
+ * assembles it. A NULL wrapper writes a page of padding instead, which is
+ * all extract_bundled_archive needs. */
+static inline int payload_write_bundle(const char *bundle,
+                                       const char *wrapper,
+                                       const char *archive_path,
+                                       struct payload_info *info) {
+  long long wrapper_bytes = 0;
+  FILE *out = fopen(bundle, "wb");
+
+  if (!out) {
+    fprintf(stderr, "Failed to create %s: %s\n", bundle, strerror(errno));
+    return -1;
+  }
+
+  int failed = 0;
+  if (wrapper) {
+    failed = payload_append_file(out, wrapper, &wrapper_bytes) != 0;
+  } else {
+    static const char padding[BUFFER_SIZE];
+    wrapper_bytes = sizeof(padding);
+    failed = fwrite(padding, 1, sizeof(padding), out) != sizeof(padding);
+  }
+  failed = failed ||
+           payload_append_file(out, archive_path, &info->archive_bytes) != 0 ||
+           fprintf(out, "%0*lld", ARCHIVE_SIZE_DIGITS, info->archive_bytes) !=
+               ARCHIVE_SIZE_DIGITS;
+  if (fclose(out) != 0 || failed || chmod(bundle, 0755) != 0) {
+    return -1;
+  }
+
+  info->bundle_bytes =
+      wrapper_bytes + info->archive_bytes + ARCHIVE_SIZE_DIGITS;
+  return 0;
+}
+
+/* Fill info from an existing bundle: the trailer gives the archive size,
+ * and the archive's headers the entries and file data size */
+static inline int payload_read_bundle(const char *bundle,
+                                      struct payload_info *info) {
+  char digits[ARCHIVE_SIZE_DIGITS + 1] = {0};
+  struct archive *ar = NULL;
+  struct archive_entry *entry;
+  size_t size = 0;
+  char *data = payload_read_file(bundle, &size);
+  int r = ARCHIVE_FATAL;
+
+  memset(info, 0, sizeof(*info));
+  if (!data || size < ARCHIVE_SIZE_DIGITS) {
+    fprintf(stderr, "Failed to read %s\n", bundle);
+    free(data);
+    return -1;
+  }
+  memcpy(digits, data + size - ARCHIVE_SIZE_DIGITS, ARCHIVE_SIZE_DIGITS);
+  info->archive_bytes = strtoll(digits, NULL, 10);
+  info->bundle_bytes = (long long)size;
+
+  if (info->archive_bytes > 0 &&
+      (size_t)info->archive_bytes <= size - ARCHIVE_SIZE_DIGITS &&
+      (ar = archive_read_new())) {
+    archive_read_support_format_all(ar);
+    archive_read_support_filter_all(ar);
+    r = archive_read_open_memory(
+        ar, data + size - ARCHIVE_SIZE_DIGITS - info->archive_bytes,
+        (size_t)info->archive_bytes);
+    while (r == ARCHIVE_OK &&
+           (r = archive_read_next_header(ar, &entry)) == ARCHIVE_OK) {
+      info->entries++;
+      if (archive_entry_filetype(entry) == AE_IFREG) {
+        info->raw += (unsigned long long)archive_entry_size(entry);
+      }
+    }
+  }
+  if (r != ARCHIVE_EOF) {
+    fprintf(stderr, "Failed to read the archive in %s: %s\n", bundle,
+            ar ? archive_error_string(ar) : "bad archive size");
+  }
+  archive_read_free(ar);
+  free(data);
+  return r == ARCHIVE_EOF ? 0 : -1;
+}
+
+#endif /* WRAPPER_BENCH_PAYLOAD_H */
@@ -0,0 +1,358 @@
+/* End-to-end startup latency of a bundled wrapper
+ *
+ * Builds a synthetic payload (a stdlib-shaped Python tree plus a stub app),
+ * appends it to a wrapper binary the same way docker-build.sh does, and
+ * measures the time from fork() to the moment the bundled "python" starts
+ * running. The stub python is this program: when started with PYB_BENCH_FD
+ * set it writes its pid and CLOCK_MONOTONIC timestamp to that descriptor and
+ * exits, so nothing after execve is measured.
+ *
+ * Scenarios, each run for -n iterations:
+ *   warm        everything installed
+ *   cold        fresh XDG_DATA_HOME, bundle evicted from the page cache
+ *   upgrade     application directory removed, Python kept
+ *   repair      both installed binaries lost their exec bit
+ *   concurrent  -c cold launches started together on one XDG_DATA_HOME
+ *
+ * Usage: startup_bench [-w wrapper] [-v version-file] [-n iterations]
+ *                      [-c concurrency] [-f files] [-o results.json]
+ */
+#include "bench.h"
+#include "logging.h"
+#include "pathutils.h"
+#include "payload.h"
+
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#define STUB_FD_ENV "PYB_BENCH_FD"
+
+/* What the stub python reports back */
+struct stub_report {
+  pid_t pid;
+  uint64_t ts_ns;
+};
+
+struct bench_setup {
+  char work_dir[PATH_MAX];   /* Scratch directory for everything below */
+  char bundle[PATH_MAX];     /* wrapper + payload + size footer */
+  char xdg[PATH_MAX];        /* XDG_DATA_HOME handed to launches */
+  char python_dir[PATH_MAX]; /* Installed Python under xdg */
+  char app_dir[PATH_MAX];    /* Installed app under xdg */
+  size_t files;              /* Files in the payload */
+  long long archive_bytes;   /* Compressed payload size */
+  long long bundle_bytes;    /* Final executable size */
+};
+
+/* Stub python: report and exit as early as possible */
+static int run_as_stub(const char *fd_env) {
+  struct stub_report rep = {.pid = getpid(), .ts_ns = bench_now_ns()};
+  int fd = atoi(fd_env);
+  return write(fd, &rep, sizeof(rep)) == (ssize_t)sizeof(rep) ? 0 : 1;
+}
+
+/* Build the bundle: this program as python, the configured version file */
+static int build_bundle(struct bench_setup *s, const char *wrapper,
+                        const char *version_file) {
+  struct payload_spec spec = {.files = s->files,
+                              .dist = PAYLOAD_STDLIB,
+                              .codec = "zstd",
+                              .level = 19};
+  struct payload_info info;
+  char archive_path[PATH_MAX];
+  char *stub, *version = NULL;
+  int rc = -1;
+
+  if (!(stub = payload_read_file("/proc/self/exe", &spec.python_bin_size))) {
+    fprintf(stderr, "Failed to read own executable\n");
+    return -1;
+  }
+  spec.python_bin = stub;
+
+  if (version_file && *version_file) {
+    version = payload_read_file(version_file, &spec.version_size);
+    spec.version = version;
+  }
+  if (VERSION_CHECKSUM > 0 && !version) {
+    fprintf(stderr, "Wrapper expects a version file; pass it with -v\n");
+    goto out;
+  }
+
+  if (path_join(archive_path, sizeof(archive_path), s->work_dir,
+                "payload.tar.zst", NULL) != WRP_OK ||
+      payload_write_archive(archive_path, &spec, &info) != 0 ||
+      payload_write_bundle(s->bundle, wrapper, archive_path, &info) != 0) {
+    goto out;
+  }
+
+  s->archive_bytes = info.archive_bytes;
+  s->bundle_bytes = info.bundle_bytes;
+  unlink(archive_path);
+  rc = 0;
+
+out:
+  free(stub);
+  free(version);
+  return rc;
+}
+
+/* Launching */
+
+/* Start `count` launches together and collect each one's fork-to-exec
+ * latency in microseconds. Returns the number of successful launches. */
+static size_t launch(const struct bench_setup *s, size_t count,
+                     uint64_t *latencies) {
+  pid_t pids[count];
+  uint64_t starts[count];
+  int pipefd[2];
+  char fd_str[16];
+  size_t ok = 0;
+
+  if (pipe(pipefd) != 0) {
+    return 0;
+  }
+  snprintf(fd_str, sizeof(fd_str), "%d", pipefd[1]);
+
+  for (size_t i = 0; i < count; i++) {
+    starts[i] = bench_now_ns();
+    pids[i] = fork();
+    if (pids[i] == 0) {
+      int devnull = open("/dev/null", O_WRONLY);
+      dup2(devnull, STDOUT_FILENO);
+      dup2(devnull, STDERR_FILENO);
+      close(pipefd[0]);
+      setenv("XDG_DATA_HOME", s->xdg, 1);
+      setenv(STUB_FD_ENV, fd_str, 1);
+      execl(s->bundle, s->bundle, (char *)NULL);
+      _exit(127);
+    }
+  }
+  close(pipefd[1]);
+
+  for (size_t i = 0; i < count; i++) {
+    if (pids[i] > 0) {
+      waitpid(pids[i], NULL, 0);
+    }
+  }
+
+  struct stub_report rep;
+  while (read(pipefd[0], &rep, sizeof(rep)) == (ssize_t)sizeof(rep)) {
+    for (size_t i = 0; i < count; i++) {
+      if (pids[i] == rep.pid) {
+        latencies[ok++] = (rep.ts_ns - starts[i]) / 1000;
+        break;
+      }
+    }
+  }
+  close(pipefd[0]);
+  return ok;
+}
+
+/* Drop the bundle from the page cache so the next launch reads it from disk
+ * (no privileges needed for clean pages) */
+static void evict_bundle(const struct bench_setup *s) {
+  int fd = open(s->bundle, O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+static void chmod_binary(const char *dir, const char *sub, const char *name,
+                         mode_t mode) {
+  char path[PATH_MAX];
+  if (path_join(path, sizeof(path), dir, sub, name, NULL) == WRP_OK) {
+    chmod(path, mode);
+  }
+}
+
+enum scenario { WARM, COLD, UPGRADE, REPAIR, CONCURRENT, SCENARIO_COUNT };
+
+static const char *scenario_names[SCENARIO_COUNT] = {
+    [WARM] = "warm",
+    [COLD] = "cold",
+    [UPGRADE] = "upgrade",
+    [REPAIR] = "repair",
+    [CONCURRENT] = "concurrent"};
+
+struct scenario_result {
+  struct bench_stats stats;
+  size_t failures;
+};
+
+static struct scenario_result run_scenario(const struct bench_setup *s,
+                                           enum scenario sc, size_t iterations,
+                                           size_t concurrency) {
+  size_t per_iter = sc == CONCURRENT ? concurrency : 1;
+  uint64_t *samples = calloc(iterations * per_iter, sizeof(*samples));
+  struct scenario_result res = {0};
+  size_t n = 0;
+
+  if (!samples) {
+    return res;
+  }
+
+  /* Warm-type scenarios start from a complete installation */
+  if (sc == WARM || sc == UPGRADE || sc == REPAIR) {
+    remove_directory_recursive(s->xdg);
+    uint64_t unused;
+    launch(s, 1, &unused);
+  }
+
+  for (size_t it = 0; it < iterations; it++) {
+    switch (sc) {
+    case COLD:
+    case CONCURRENT:
+      remove_directory_recursive(s->xdg);
+      evict_bundle(s);
+      break;
+    case UPGRADE:
+      remove_directory_recursive(s->app_dir);
+      break;
+    case REPAIR:
+      chmod_binary(s->python_dir, "bin", "python", 0644);
+      chmod_binary(s->app_dir, "bin", BINARY_NAME, 0644);
+      break;
+    default:
+      break;
+    }
+
+    size_t got = launch(s, per_iter, samples + n);
+    res.failures += per_iter - got;
+    n += got;
+  }
+
+  res.stats = bench_summarize(samples, n);
+  free(samples);
+  return res;
+}
+
+static void print_json(FILE *f, const struct bench_setup *s,
+                       const struct scenario_result *results,
+                       size_t iterations, size_t concurrency) {
+  fprintf(f, "{\n  \"bench\": \"startup\",\n");
+  fprintf(f, "  \"unit\": \"us\",\n");
+  fprintf(f, "  \"iterations\": %zu,\n  \"concurrency\": %zu,\n", iterations,
+          concurrency);
+  fprintf(f,
+          "  \"payload\": {\"files\": %zu, \"archive_bytes\": %lld, "
+          "\"bundle_bytes\": %lld},\n",
+          s->files, s->archive_bytes, s->bundle_bytes);
+  fprintf(f, "  \"scenarios\": {\n");
+  for (int sc = 0; sc < SCENARIO_COUNT; sc++) {
+    const struct bench_stats *st = &results[sc].stats;
+    fprintf(f,
+            "    \"%s\": {\"runs\": %zu, \"failures\": %zu, \"min\": %llu, "
+            "\"p50\": %llu, \"p95\": %llu, \"p99\": %llu, \"max\": %llu, "
+            "\"mean\": %.1f}%s\n",
+            scenario_names[sc], st->runs, results[sc].failures,
+            (unsigned long long)st->min, (unsigned long long)st->p50,
+            (unsigned long long)st->p95, (unsigned long long)st->p99,
+            (unsigned long long)st->max, st->mean,
+            sc + 1 < SCENARIO_COUNT ? "," : "");
+  }
+  fprintf(f, "  }\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+  struct bench_setup setup = {.files = 2000};
+  struct scenario_result results[SCENARIO_COUNT];
+  const char *wrapper = getenv("BENCH_WRAPPER");
+  const char *version_file = getenv("BENCH_VERSION_FILE");
+  const char *json_path = NULL;
+  const char *stub_fd = getenv(STUB_FD_ENV);
+  size_t iterations = 20;
+  size_t concurrency = 8;
+  int opt;
+
+  if (stub_fd) {
+    return run_as_stub(stub_fd);
+  }
+
+  log_init(LOG_INFO, 0);
+
+  while ((opt = getopt(argc, argv, "w:v:n:c:f:o:")) != -1) {
+    switch (opt) {
+    case 'w':
+      wrapper = optarg;
+      break;
+    case 'v':
+      version_file = optarg;
+      break;
+    case 'n':
+      iterations = strtoul(optarg, NULL, 10);
+      break;
+    case 'c':
+      concurrency = strtoul(optarg, NULL, 10);
+      break;
+    case 'f':
+      setup.files = strtoul(optarg, NULL, 10);
+      break;
+    case 'o':
+      json_path = optarg;
+      break;
+    default:
+      fprintf(stderr,
+              "Usage: %s [-w wrapper] [-v version-file] [-n iterations] "
+              "[-c concurrency] [-f files] [-o results.json]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!wrapper || !*wrapper) {
+    wrapper = "./" BINARY_NAME;
+  }
+  if (iterations == 0 || concurrency == 0) {
+    fprintf(stderr, "Iterations and concurrency must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *tmp = getenv("TMPDIR");
+  snprintf(setup.work_dir, sizeof(setup.work_dir), "%s/startup-bench.XXXXXX",
+           tmp && *tmp ? tmp : "/tmp");
+  if (!mkdtemp(setup.work_dir)) {
+    fprintf(stderr, "Failed to create work directory: %s\n", strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  if (path_join(setup.bundle, sizeof(setup.bundle), setup.work_dir,
+                BINARY_NAME, NULL) != WRP_OK ||
+      path_join(setup.xdg, sizeof(setup.xdg), setup.work_dir, "xdg", NULL) !=
+          WRP_OK ||
+      path_join(setup.python_dir, sizeof(setup.python_dir), setup.xdg,
+                PYBSTRAP_SUBDIR, "python", PYTHON_VERSION, NULL) != WRP_OK ||
+      path_join(setup.app_dir, sizeof(setup.app_dir), setup.xdg,
+                PYBSTRAP_SUBDIR, "apps", BINARY_NAME, NULL) != WRP_OK ||
+      build_bundle(&setup, wrapper, version_file) != 0) {
+    fprintf(stderr, "Failed to build benchmark bundle\n");
+    remove_directory_recursive(setup.work_dir);
+    return EXIT_FAILURE;
+  }
+
+  printf("Bundle: %zu files, %lld byte payload, %lld bytes total\n",
+         setup.files, setup.archive_bytes, setup.bundle_bytes);
+  printf("%-11s %6s %5s %9s %9s %9s %9s  (us)\n", "scenario", "runs", "fail",
+         "p50", "p95", "p99", "max");
+
+  int failed = 0;
+  for (int sc = 0; sc < SCENARIO_COUNT; sc++) {
+    results[sc] = run_scenario(&setup, sc, iterations, concurrency);
+    const struct bench_stats *st = &results[sc].stats;
+    printf("%-11s %6zu %5zu %9llu %9llu %9llu %9llu\n", scenario_names[sc],
+           st->runs, results[sc].failures, (unsigned long long)st->p50,
+           (unsigned long long)st->p95, (unsigned long long)st->p99,
+           (unsigned long long)st->max);
+    failed |= st->runs == 0;
+  }
+
+  FILE *json = bench_json_open(json_path);
+  if (json) {
+    print_json(json, &setup, results, iterations, concurrency);
+    fclose(json);
+  }
+
+  remove_directory_recursive(setup.work_dir);
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
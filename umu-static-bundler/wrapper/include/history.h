@@ -0,0 +1,92 @@
+#ifndef WRAPPER_HISTORY_H
+#define WRAPPER_HISTORY_H
+
+#include "wrapper.h"
+#include <stdint.h>
+
+/* Launch history
+ *
+ * Every launch appends one fixed-size record to a ring file in base_dir
+ * (HISTORY_FILE), so cold starts, repairs and lock contention seen on real
+ * machines can be summarised later with --pyb-stats. Set PYB_HISTORY=0 to
+ * disable recording.
+ *
+ * File layout: a struct history_header followed by `capacity` records. The
+ * header's `count` is the total number of launches ever recorded; the next
+ * record goes to slot count % capacity. Writers hold flock(LOCK_EX) on the
+ * file while updating it.
+ */
+
+#define HISTORY_FILE "launch-history"
+#define HISTORY_MAGIC "PYBHIST1"
+#define HISTORY_VERSION 1
+#define HISTORY_CAPACITY 1024
+
+/* Which way through ensure_components a launch went */
+typedef enum {
+  HISTORY_WARM = 0,    /* Everything already installed */
+  HISTORY_UPGRADE = 1, /* One component replaced */
+  HISTORY_REPAIR = 2,  /* A broken installation was re-extracted */
+  HISTORY_COLD = 3,    /* Both components installed */
+  HISTORY_PATH_COUNT
+} history_path_t;
+
+/* Timed launch phases */
+typedef enum {
+  HISTORY_PHASE_CONFIG = 0,  /* init_wrapper_config */
+  HISTORY_PHASE_VERIFY = 1,  /* verify_python_install + verify_app_install */
+  HISTORY_PHASE_LOCK = 2,    /* Waiting for the installation lock */
+  HISTORY_PHASE_CLEANUP = 3, /* Removing a stale .tmp */
+  HISTORY_PHASE_EXTRACT = 4, /* extract_bundled_archive */
+  HISTORY_PHASE_INSTALL = 5, /* atomic_replace_directory, all components */
+  HISTORY_PHASE_ENV = 6,     /* setup_python_environment */
+  HISTORY_PHASE_COUNT
+} history_phase_t;
+
+struct history_header {
+  char magic[8];         /* HISTORY_MAGIC, not NUL terminated */
+  uint32_t version;      /* HISTORY_VERSION */
+  uint32_t record_size;  /* sizeof(struct history_record) */
+  uint32_t capacity;     /* Number of record slots */
+  uint32_t reserved;     /* Zero */
+  uint64_t count;        /* Launches recorded so far */
+  unsigned char pad[32]; /* Zero, keeps records 64-byte aligned */
+};
+
+struct history_record {
+  uint64_t timestamp;                     /* Wall clock, seconds since epoch */
+  uint64_t payload_hash;                  /* FNV-1a of the executable's tail */
+  uint64_t bytes_extracted;               /* File data written by extraction */
+  uint32_t total_us;                      /* Process start to exec or exit */
+  uint32_t phase_us[HISTORY_PHASE_COUNT]; /* Per-phase durations */
+  uint8_t path;                           /* history_path_t */
+  int8_t status;                          /* wrp_status_t of the launch */
+  uint8_t phases;                         /* Bit n set if phase n ran */
+  uint8_t reserved[5];                    /* Zero */
+};
+
+/* Mark the start of the launch; call first thing in main */
+void history_begin(void);
+
+/* Set the directory holding the history file; nothing is recorded without it */
+void history_set_dir(const char *base_dir);
+
+/* Add a phase duration (phases that run more than once accumulate) */
+void history_phase(history_phase_t phase, uint64_t duration_us);
+
+/* Record which installation path the launch took */
+void history_set_path(history_path_t path);
+
+/* Add to the extracted byte count */
+void history_add_extracted(unsigned long long bytes);
+
+/* Append this launch's record. Only the first call appends; a later call
+ * with a failure status marks a record committed as WRP_OK just before exec
+ * as failed, so it is safe to call both before exec and after it returns.
+ * errno is left as it was, for the error report that follows. */
+void history_commit(wrp_status_t status);
+
+/* Print a summary of the history file in base_dir to stdout */
+wrp_status_t history_report(const char *base_dir);
+
+#endif /* WRAPPER_HISTORY_H */
@@ -21,6 +21,12 @@ void log_set_colors(int use_colors);
 log_level_t log_get_level(void);
 int log_get_colors(void);
 
+/* PYB_LOG_FILE=<path> additionally records every message, debug included,
+ * with timestamps and pid. Records are buffered in memory and written when
+ * the buffer fills, after an error, at exit, or by an explicit flush (needed
+ * before exec). */
+void log_flush(void);
+
 /* Debug logging enabled if either:
  * - DEBUG defined at compile-time AND
  * - PYB_DEBUG=1 environment variable set at runtime
@@ -0,0 +1,61 @@
+#ifndef WRAPPER_PATHSCAN_H
+#define WRAPPER_PATHSCAN_H
+
+#include "wrapper.h"
+
+/* Findings reported by path_scan_entry, combined as a bitmask */
+typedef enum {
+  SCAN_CLEAN = 0,
+  SCAN_DOT = 1 << 0,           /* "." component */
+  SCAN_DOTDOT = 1 << 1,        /* ".." component */
+  SCAN_DOUBLE_SLASH = 1 << 2,  /* Empty component from doubled slashes */
+  SCAN_CONTROL = 1 << 3,       /* NUL, DEL or other control character */
+  SCAN_ABSOLUTE = 1 << 4,      /* Leading slash */
+  SCAN_OUTSIDE = 1 << 5,       /* Not inside the requested section */
+  SCAN_SECTION_ROOT = 1 << 6   /* The section itself, without its slash */
+} scan_flags_t;
+
+/* Names that cannot take the single-pass route and need the pathutils
+ * helpers to decide what they mean */
+#define SCAN_NEEDS_SLOWPATH (SCAN_DOT | SCAN_DOUBLE_SLASH | SCAN_SECTION_ROOT)
+
+/* Names that must never be extracted */
+#define SCAN_UNSAFE (SCAN_DOTDOT | SCAN_CONTROL)
+
+/* Result of a single-pass archive entry name scan */
+struct path_scan {
+  size_t rel_offset; /* Start of the section-relative name ("./" skipped) */
+  size_t length;     /* Length of the scanned name */
+  unsigned flags;    /* SCAN_* findings */
+};
+
+/* Validate an archive entry name against a section in one pass
+ *
+ * Parameters:
+ *   name    - Entry name as stored in the archive
+ *   len     - Length of name in bytes (embedded NULs are reported)
+ *   section - Section prefix such as SECTION_PYTHON
+ *   scan    - Receives the findings and the section-relative offset
+ *
+ * Returns:
+ *   WRP_OK when the name was scanned, regardless of what was found
+ *   PATH_INVALID for missing parameters
+ *   PATH_TOOLONG for names of PATH_MAX bytes or more
+ *
+ * name + scan->rel_offset is what path_strip_archive_prefix produces for
+ * names in the section. The vector kernel is picked once from the CPU
+ * features, falling back to a scalar loop.
+ */
+wrp_status_t path_scan_entry(const char *name, size_t len, const char *section,
+                             struct path_scan *scan);
+
+/* Name of the active scan kernel ("avx2", "sse2" or "scalar") */
+const char *path_scan_impl(void);
+
+/* Force a scan kernel by name, for benchmarking and cross-checking
+ *
+ * Returns PATH_INVALID if the kernel is unknown or unsupported by this CPU.
+ */
+wrp_status_t path_scan_select(const char *impl);
+
+#endif /* WRAPPER_PATHSCAN_H */
@@ -0,0 +1,136 @@
+#ifndef WRAPPER_STATS_H
+#define WRAPPER_STATS_H
+
+#include "wrapper.h"
+#include <stdint.h>
+
+/* Resource and syscall accounting
+ *
+ * Enabled by PYB_STATS=1. The wrapper opens perf_event_open counters for
+ * itself (task clock, page faults, context switches and, where the kernel
+ * allows it, instructions) and samples them at the start and end of every
+ * trace span. Counters perf events cannot provide (e.g. under a seccomp
+ * profile that blocks perf_event_open) come from getrusage() instead. The
+ * per-span deltas are printed to stderr just before execve, or at exit if
+ * the launch fails.
+ *
+ * Filesystem calls in pathutils.c and utils.c go through the stats_*
+ * wrappers below, which count them by category. Counting is always on; it
+ * is a single increment per call.
+ */
+
+/* Syscall categories */
+typedef enum {
+  STATS_SYS_OPEN = 0,   /* open, fopen, opendir */
+  STATS_SYS_STAT = 1,   /* stat, lstat, access, readlink, realpath */
+  STATS_SYS_MKDIR = 2,  /* mkdir, mkdtemp */
+  STATS_SYS_RENAME = 3, /* rename */
+  STATS_SYS_REMOVE = 4, /* unlink, rmdir */
+  STATS_SYS_COUNT
+} stats_sys_t;
+
+/* Sampled counters */
+typedef enum {
+  STATS_WALL = 0,         /* CLOCK_MONOTONIC, ns */
+  STATS_TASK_CLOCK = 1,   /* CPU time, ns */
+  STATS_MINFLT = 2,       /* Minor page faults */
+  STATS_MAJFLT = 3,       /* Major page faults */
+  STATS_CTXSW = 4,        /* Context switches */
+  STATS_INSTRUCTIONS = 5, /* Retired instructions, perf events only */
+  STATS_COUNTER_COUNT
+} stats_counter_t;
+
+/* A point-in-time reading of every counter */
+struct stats_sample {
+  uint64_t counters[STATS_COUNTER_COUNT];
+  uint32_t syscalls[STATS_SYS_COUNT];
+};
+
+/* Open the counters if PYB_STATS is set */
+void stats_init(void);
+
+/* Non-zero if PYB_STATS is active */
+int stats_enabled(void);
+
+/* Count one syscall in the given category */
+void stats_count(stats_sys_t category);
+
+/* Read the counters into sample; does nothing unless stats are enabled */
+void stats_sample(struct stats_sample *sample);
+
+/* Add the counters' progress since start to the row for name. Rows are
+ * keyed by name, so phases that run more than once accumulate. */
+void stats_record(const char *name, const struct stats_sample *start);
+
+/* Print the per-phase table to stderr. Only the first call prints. */
+void stats_report(void);
+
+/* Counting wrappers */
+
+static inline int stats_open(const char *path, int flags, mode_t mode) {
+  stats_count(STATS_SYS_OPEN);
+  return open(path, flags, mode);
+}
+
+static inline FILE *stats_fopen(const char *path, const char *mode) {
+  stats_count(STATS_SYS_OPEN);
+  return fopen(path, mode);
+}
+
+static inline DIR *stats_opendir(const char *path) {
+  stats_count(STATS_SYS_OPEN);
+  return opendir(path);
+}
+
+static inline int stats_stat(const char *path, struct stat *st) {
+  stats_count(STATS_SYS_STAT);
+  return stat(path, st);
+}
+
+static inline int stats_lstat(const char *path, struct stat *st) {
+  stats_count(STATS_SYS_STAT);
+  return lstat(path, st);
+}
+
+static inline int stats_access(const char *path, int mode) {
+  stats_count(STATS_SYS_STAT);
+  return access(path, mode);
+}
+
+static inline ssize_t stats_readlink(const char *path, char *buf,
+                                     size_t size) {
+  stats_count(STATS_SYS_STAT);
+  return readlink(path, buf, size);
+}
+
+static inline char *stats_realpath(const char *path, char *resolved) {
+  stats_count(STATS_SYS_STAT);
+  return realpath(path, resolved);
+}
+
+static inline int stats_mkdir(const char *path, mode_t mode) {
+  stats_count(STATS_SYS_MKDIR);
+  return mkdir(path, mode);
+}
+
+static inline char *stats_mkdtemp(char *template) {
+  stats_count(STATS_SYS_MKDIR);
+  return mkdtemp(template);
+}
+
+static inline int stats_rename(const char *from, const char *to) {
+  stats_count(STATS_SYS_RENAME);
+  return rename(from, to);
+}
+
+static inline int stats_unlink(const char *path) {
+  stats_count(STATS_SYS_REMOVE);
+  return unlink(path);
+}
+
+static inline int stats_rmdir(const char *path) {
+  stats_count(STATS_SYS_REMOVE);
+  return rmdir(path);
+}
+
+#endif /* WRAPPER_STATS_H */
@@ -0,0 +1,51 @@
+#ifndef WRAPPER_TRACE_H
+#define WRAPPER_TRACE_H
+
+#include "stats.h"
+#include "wrapper.h"
+#include <stdint.h>
+
+/* Phase tracing in Chrome trace-event format
+ *
+ * Enabled by PYB_TRACE=<path>. Events are appended to <path> as a JSON array
+ * ("[" followed by one event object per line, each ending in a comma), which
+ * chrome://tracing and Perfetto load without a closing bracket. Timestamps
+ * are CLOCK_MONOTONIC microseconds, so anything running after execve can
+ * append its own spans with the same pid and clock (see pyb_trace.py).
+ */
+
+/* A begin/end span; start_us is kept even when tracing is off so callers can
+ * use the returned duration. Spans are also the phases PYB_STATS reports. */
+struct trace_span {
+  const char *name;
+  uint64_t start_us;
+  struct stats_sample stats;
+};
+
+/* Open the trace file named by PYB_TRACE, if set */
+void trace_init(void);
+
+/* Non-zero if events are being written */
+int trace_enabled(void);
+
+/* CLOCK_MONOTONIC in microseconds */
+uint64_t trace_now_us(void);
+
+/* Record the start of a span */
+void trace_begin(struct trace_span *span, const char *name);
+
+/* Record the end of a span and return its duration in microseconds */
+uint64_t trace_end(struct trace_span *span);
+
+/* As trace_end, attaching fmt as the body of the event's "args" object,
+ * e.g. "\"entries\":%zu" */
+uint64_t trace_end_args(struct trace_span *span, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Record a point-in-time event */
+void trace_instant(const char *name);
+
+/* Close the trace file; later events are dropped */
+void trace_close(void);
+
+#endif /* WRAPPER_TRACE_H */
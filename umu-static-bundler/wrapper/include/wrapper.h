@@ -53,12 +53,21 @@ typedef enum {
 /* Size of the archive size footer in digits */
 #define ARCHIVE_SIZE_DIGITS 20
 
+/* The archive ends in a zstd skippable frame recording how it was packed:
+ * magic and content length (little endian), "key=value ..." text, then the
+ * frame's total size so it can be found from the end. Decoders skip it. */
+#define PAYLOAD_PROFILE_MAGIC 0x184D2A5Bu
+#define PAYLOAD_PROFILE_MAX 256
+
 /* Lock file timeout in seconds */
 #define LOCK_TIMEOUT 5
 
 /* Base directory for all installations */
 #define PYBSTRAP_SUBDIR "pybstrap"
 
+/* Directory under base_dir for PYB_PROFILE_IMPORTS output */
+#define IMPORT_PROFILE_SUBDIR "import-profiles"
+
 /* Archive section identifiers */
 #define SECTION_PYTHON "./python/"
 #define SECTION_APP "./apps/"
@@ -119,7 +128,8 @@ wrp_status_t verify_app_install(const char *app_dir,
                                 int *needs_repair);
 
 /* Environment setup function */
-wrp_status_t setup_python_environment(const char *app_dir,
+wrp_status_t setup_python_environment(const char *base_dir,
+                                      const char *app_dir,
                                       const char *python_dir);
 
 /* Helper for safe path construction */
@@ -6,6 +6,7 @@
 #define BINARY_NAME "wrapper"
 #define PYTHON_VERSION "3.13.0"
 #define VERSION_FILE "version.json"
+#define PYTHON_MALLOC ""
 
 #define VERSION_CHECKSUM 0
 
@@ -1,5 +1,8 @@
+#include "history.h"
 #include "logging.h"
+#include "pathscan.h"
 #include "pathutils.h"
+#include "trace.h"
 #include "wrapper.h"
 
 /* Get the size of a file in bytes */
@@ -64,14 +67,23 @@ static int copy_archive_data(struct archive *ar, struct archive *aw) {
 
 /* Archive extraction context */
 struct archive_context {
-  struct archive *ar;     /* Archive reader */
-  struct archive *aw;     /* Archive writer */
-  FILE *file;             /* Input file handle */
-  void *buffer;           /* Archive buffer */
-  char *target_dir;       /* Extraction target directory */
-  const char *section;    /* Section being extracted */
-  size_t files_extracted; /* Number of files extracted */
-  int flags;              /* Extraction flags */
+  struct archive *ar;           /* Archive reader */
+  struct archive *aw;           /* Archive writer */
+  FILE *file;                   /* Input file handle */
+  void *buffer;                 /* Archive buffer */
+  char *target_dir;             /* Extraction target directory */
+  size_t target_len;            /* Length of target_dir */
+  const char *section;          /* Section being extracted */
+  size_t files_extracted;       /* Number of files extracted */
+  unsigned long long bytes_out; /* File data bytes written */
+  int flags;                    /* Extraction flags */
+};
+
+/* Per-section extraction totals */
+struct extract_stats {
+  size_t entries;               /* Entries written */
+  unsigned long long bytes_in;  /* Compressed bytes consumed */
+  unsigned long long bytes_out; /* File data bytes written */
 };
 
 /* Initialize archive extraction context */
@@ -91,6 +103,10 @@ static wrp_status_t init_archive_context(struct archive_context *ctx,
   if (!ctx->target_dir) {
     return WRP_EERRNO;
   }
+  ctx->target_len = strlen(ctx->target_dir);
+  while (ctx->target_len > 1 && ctx->target_dir[ctx->target_len - 1] == '/') {
+    ctx->target_len--;
+  }
 
   return WRP_OK;
 }
@@ -117,24 +133,65 @@ static void cleanup_archive_context(void *ctx) {
   free(ac->target_dir);
 }
 
-/* Process a single archive entry */
-static wrp_status_t process_archive_entry(struct archive_context *ctx,
-                                          struct archive_entry *entry) {
-  wrp_status_t status;
+/* Resolve an entry name to its extraction path using the single-pass scanner,
+ * falling back to the pathutils helpers for names that need normalization.
+ * Sets *in_section to 0 for entries outside the section being extracted. */
+static wrp_status_t resolve_entry_path(struct archive_context *ctx,
+                                       const char *entry_path, char *dest,
+                                       size_t size, int *in_section) {
+  struct path_scan scan;
   char full_path[PATH_MAX];
-  char norm_path[PATH_MAX];
   char rel_path[PATH_MAX];
+  wrp_status_t status;
   int is_subpath;
-  const char *entry_path = archive_entry_pathname(entry);
-  int r;
+
+  status = path_scan_entry(entry_path, strlen(entry_path), ctx->section, &scan);
+  if (status != WRP_OK) {
+    return handle_error(status, NULL, NULL, "Invalid archive entry name: %s",
+                        entry_path);
+  }
+
+  /* Entries outside the section are skipped before the safety check */
+  if (scan.flags & SCAN_UNSAFE) {
+    if (path_is_subpath(ctx->section, entry_path, &is_subpath) != WRP_OK ||
+        !is_subpath) {
+      *in_section = 0;
+      return WRP_OK;
+    }
+    return handle_error(WRP_EINVAL, NULL, NULL,
+                        "Unsafe archive entry name: %s", entry_path);
+  }
+
+  if (!(scan.flags & SCAN_NEEDS_SLOWPATH)) {
+    *in_section = !(scan.flags & SCAN_OUTSIDE);
+    if (!*in_section) {
+      return WRP_OK;
+    }
+
+    /* Already normalized apart from a trailing slash on directories */
+    size_t rel_len = scan.length - scan.rel_offset;
+    if (rel_len > 0 && entry_path[scan.rel_offset + rel_len - 1] == '/') {
+      rel_len--;
+    }
+    if (ctx->target_len + 1 + rel_len >= size) {
+      return handle_error(WRP_EINVAL, NULL, NULL,
+                          "Failed to construct path for: %s", entry_path);
+    }
+
+    memcpy(dest, ctx->target_dir, ctx->target_len);
+    dest[ctx->target_len] = '/';
+    memcpy(dest + ctx->target_len + 1, entry_path + scan.rel_offset, rel_len);
+    dest[ctx->target_len + 1 + rel_len] = '\0';
+    return WRP_OK;
+  }
 
   /* Check if entry is in the requested section */
   if (path_is_subpath(ctx->section, entry_path, &is_subpath) != WRP_OK ||
       !is_subpath) {
-    log_debug("Skipping entry not in section %s: %s", ctx->section, entry_path);
-    archive_read_data_skip(ctx->ar);
+    *in_section = 0;
     return WRP_OK;
   }
+  *in_section = 1;
 
   /* Strip archive prefix to get relative path */
   status = path_strip_archive_prefix(rel_path, sizeof(rel_path), entry_path,
@@ -152,19 +209,48 @@ static wrp_status_t process_archive_entry(struct archive_context *ctx,
   }
 
   /* Normalize and verify the path */
-  strcpy(norm_path, full_path);
-  if (path_normalize(norm_path, sizeof(norm_path)) != WRP_OK) {
+  if (strlen(full_path) >= size) {
+    return handle_error(WRP_EINVAL, NULL, NULL,
+                        "Failed to construct path for: %s", entry_path);
+  }
+  strcpy(dest, full_path);
+  if (path_normalize(dest, size) != WRP_OK) {
     return handle_error(WRP_EINVAL, NULL, NULL, "Failed to normalize path: %s",
                         full_path);
   }
 
   /* Verify the normalized path is still under target directory */
-  if (path_is_subpath(ctx->target_dir, norm_path, &is_subpath) != WRP_OK ||
+  if (path_is_subpath(ctx->target_dir, dest, &is_subpath) != WRP_OK ||
       !is_subpath) {
     return handle_error(WRP_EINVAL, NULL, NULL,
                         "Path escapes target directory: %s", entry_path);
   }
 
+  return WRP_OK;
+}
+
+/* Process a single archive entry */
+static wrp_status_t process_archive_entry(struct archive_context *ctx,
+                                          struct archive_entry *entry) {
+  wrp_status_t status;
+  char norm_path[PATH_MAX];
+  int in_section = 0;
+  const char *entry_path = archive_entry_pathname(entry);
+  int r;
+
+  status = resolve_entry_path(ctx, entry_path, norm_path, sizeof(norm_path),
+                              &in_section);
+  if (status != WRP_OK) {
+    return status;
+  }
+
+  /* Check if entry is in the requested section */
+  if (!in_section) {
+    log_debug("Skipping entry not in section %s: %s", ctx->section, entry_path);
+    archive_read_data_skip(ctx->ar);
+    return WRP_OK;
+  }
+
   /* Create parent directory */
   status = path_ensure_parent_directory(norm_path, 0700);
   if (status != WRP_OK) {
@@ -186,8 +272,9 @@ static wrp_status_t process_archive_entry(struct archive_context *ctx,
     r = copy_archive_data(ctx->ar, ctx->aw);
     if (r != ARCHIVE_OK) {
       return handle_error(WRP_EEXTRACT, NULL, NULL,
-                          "Failed to extract file: %s", full_path);
+                          "Failed to extract file: %s", norm_path);
     }
+    ctx->bytes_out += (unsigned long long)archive_entry_size(entry);
   }
 
   r = archive_write_finish_entry(ctx->aw);
@@ -201,10 +288,37 @@ static wrp_status_t process_archive_entry(struct archive_context *ctx,
   return WRP_OK;
 }
 
+static uint32_t get_le32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+/* Log the settings the archive was packed with, from its profile frame */
+static void log_payload_profile(const unsigned char *buffer,
+                                unsigned long long size) {
+  const unsigned char *frame;
+  uint32_t total;
+
+  if (size < 12) {
+    return;
+  }
+  total = get_le32(buffer + size - 4);
+  if (total < 12 || total > size || total > PAYLOAD_PROFILE_MAX + 12) {
+    return;
+  }
+  frame = buffer + size - total;
+  if (get_le32(frame) != PAYLOAD_PROFILE_MAGIC ||
+      get_le32(frame + 4) != total - 8) {
+    return;
+  }
+  log_debug("Payload profile: %.*s", (int)(total - 12), frame + 8);
+}
+
 /* Extract archive section to target directory */
 static wrp_status_t extract_archive_section(const char *self_path,
                                             const char *target_dir,
-                                            const char *section_prefix) {
+                                            const char *section_prefix,
+                                            struct extract_stats *stats) {
   struct archive_context ctx;
   wrp_status_t status;
   long archive_start;
@@ -244,6 +358,7 @@ static wrp_status_t extract_archive_section(const char *self_path,
       fread(ctx.buffer, 1, archive_size, ctx.file) != archive_size) {
     return handle_error(WRP_EERRNO, NULL, NULL, "Failed to read archive data");
   }
+  log_payload_profile(ctx.buffer, archive_size);
 
   /* Initialize archive reader */
   if (!(ctx.ar = archive_read_new())) {
@@ -282,6 +397,10 @@ static wrp_status_t extract_archive_section(const char *self_path,
                         archive_error_string(ctx.ar));
   }
 
+  stats->entries = ctx.files_extracted;
+  stats->bytes_in = (unsigned long long)archive_filter_bytes(ctx.ar, -1);
+  stats->bytes_out = ctx.bytes_out;
+
   if (ctx.files_extracted == 0) {
     log_debug("No files found in section: %s", section_prefix);
     return WRP_ENOENT;
@@ -292,6 +411,26 @@ static wrp_status_t extract_archive_section(const char *self_path,
   return WRP_OK;
 }
 
+/* Extract one section inside a trace span carrying its totals */
+static wrp_status_t extract_section_traced(const char *self_path,
+                                           const char *target_dir,
+                                           const char *section_prefix) {
+  struct extract_stats stats = {0};
+  struct trace_span span;
+  wrp_status_t status;
+
+  trace_begin(&span, "extract_section");
+  status = extract_archive_section(self_path, target_dir, section_prefix,
+                                   &stats);
+  trace_end_args(&span,
+                 "\"section\":\"%s\",\"entries\":%zu,\"bytes_in\":%llu,"
+                 "\"bytes_out\":%llu,\"status\":%d",
+                 section_prefix, stats.entries, stats.bytes_in, stats.bytes_out,
+                 status);
+  history_add_extracted(stats.bytes_out);
+  return status;
+}
+
 /* Public function to extract specified sections */
 wrp_status_t extract_bundled_archive(const char *self_path,
                                      const char *target_dir,
@@ -315,7 +454,7 @@ wrp_status_t extract_bundled_archive(const char *self_path,
   /* Extract Python section if requested */
   if (flags & INSTALL_PYTHON) {
     log_info("Extracting Python files...");
-    status = extract_archive_section(self_path, target_dir, SECTION_PYTHON);
+    status = extract_section_traced(self_path, target_dir, SECTION_PYTHON);
     if (status != WRP_OK && status != WRP_ENOENT) {
       path_cleanup_temp_dir(target_dir);
       return handle_error(status, NULL, NULL,
@@ -326,7 +465,7 @@ wrp_status_t extract_bundled_archive(const char *self_path,
   /* Extract application section if requested */
   if (flags & INSTALL_APP) {
     log_info("Extracting application files...");
-    status = extract_archive_section(self_path, target_dir, SECTION_APP);
+    status = extract_section_traced(self_path, target_dir, SECTION_APP);
     if (status != WRP_OK) {
       path_cleanup_temp_dir(target_dir);
       return handle_error(status, NULL, NULL,
@@ -1,5 +1,7 @@
+#include "history.h"
 #include "logging.h"
 #include "pathutils.h"
+#include "trace.h"
 #include "wrapper.h"
 
 /* Initialize wrapper configuration with paths and metadata */
@@ -94,6 +96,7 @@ wrp_status_t init_wrapper_config(struct wrapper_config *config,
 
 int run_wrapped_application(const struct wrapper_config *config, int argc,
                             char *argv[]) {
+  struct trace_span span;
   wrp_status_t status;
   char exe_path[PATH_MAX];
 
@@ -128,8 +131,11 @@ int run_wrapped_application(const struct wrapper_config *config, int argc,
   }
 
   /* Set up environment and execute */
-  status =
-      setup_python_environment(config->paths.app_dir, config->paths.python_dir);
+  trace_begin(&span, "setup_python_environment");
+  status = setup_python_environment(config->paths.base_dir,
+                                    config->paths.app_dir,
+                                    config->paths.python_dir);
+  history_phase(HISTORY_PHASE_ENV, trace_end(&span));
   if (status != WRP_OK) {
     return EXIT_FAILURE;
   }
@@ -0,0 +1,398 @@
+#include "history.h"
+#include "logging.h"
+#include "pathutils.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <time.h>
+
+/* Bytes at the end of the executable hashed to identify the payload. The
+ * tail covers the end of the compressed stream and the size footer, which
+ * differ between any two builds. */
+#define HISTORY_HASH_SPAN 4096
+
+_Static_assert(sizeof(struct history_header) == 64,
+               "history header must stay 64 bytes");
+_Static_assert(sizeof(struct history_record) == 64,
+               "history record must stay 64 bytes");
+
+static const char *path_names[HISTORY_PATH_COUNT] = {
+    [HISTORY_WARM] = "warm",
+    [HISTORY_UPGRADE] = "upgrade",
+    [HISTORY_REPAIR] = "repair",
+    [HISTORY_COLD] = "cold"};
+
+static const char *phase_names[HISTORY_PHASE_COUNT] = {
+    [HISTORY_PHASE_CONFIG] = "config",
+    [HISTORY_PHASE_VERIFY] = "verify",
+    [HISTORY_PHASE_LOCK] = "lock_wait",
+    [HISTORY_PHASE_CLEANUP] = "cleanup_tmp",
+    [HISTORY_PHASE_EXTRACT] = "extract",
+    [HISTORY_PHASE_INSTALL] = "install",
+    [HISTORY_PHASE_ENV] = "setup_env"};
+
+/* The record for the running launch */
+static struct {
+  struct history_record record;
+  uint64_t start_us;
+  const char *base_dir;
+  int committed;
+  int written;    /* The record reached the file */
+  uint64_t index; /* Its position in the header's count */
+} history_state;
+
+static uint32_t clamp_us(uint64_t us) {
+  return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+void history_begin(void) { history_state.start_us = trace_now_us(); }
+
+void history_set_dir(const char *base_dir) {
+  history_state.base_dir = base_dir;
+}
+
+void history_phase(history_phase_t phase, uint64_t duration_us) {
+  struct history_record *rec = &history_state.record;
+  rec->phase_us[phase] = clamp_us(rec->phase_us[phase] + duration_us);
+  rec->phases |= (uint8_t)(1u << phase);
+}
+
+void history_set_path(history_path_t path) {
+  history_state.record.path = (uint8_t)path;
+}
+
+void history_add_extracted(unsigned long long bytes) {
+  history_state.record.bytes_extracted += bytes;
+}
+
+/* FNV-1a over the last HISTORY_HASH_SPAN bytes of our own executable */
+static uint64_t hash_payload(void) {
+  unsigned char buf[HISTORY_HASH_SPAN];
+  uint64_t hash = 0xcbf29ce484222325ull;
+  struct stat st;
+  ssize_t n = 0;
+
+  int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  if (fstat(fd, &st) == 0) {
+    off_t off = st.st_size > HISTORY_HASH_SPAN ? st.st_size - HISTORY_HASH_SPAN
+                                               : 0;
+    n = pread(fd, buf, sizeof(buf), off);
+  }
+  close(fd);
+
+  for (ssize_t i = 0; i < n; i++) {
+    hash ^= buf[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+/* Read the header, or set up a fresh one if the file is new or unusable */
+static int load_header(int fd, struct history_header *hdr) {
+  ssize_t n = pread(fd, hdr, sizeof(*hdr), 0);
+
+  if (n == (ssize_t)sizeof(*hdr) &&
+      memcmp(hdr->magic, HISTORY_MAGIC, sizeof(hdr->magic)) == 0 &&
+      hdr->version == HISTORY_VERSION &&
+      hdr->record_size == sizeof(struct history_record) &&
+      hdr->capacity == HISTORY_CAPACITY) {
+    return 1;
+  }
+
+  memset(hdr, 0, sizeof(*hdr));
+  memcpy(hdr->magic, HISTORY_MAGIC, sizeof(hdr->magic));
+  hdr->version = HISTORY_VERSION;
+  hdr->record_size = sizeof(struct history_record);
+  hdr->capacity = HISTORY_CAPACITY;
+  return 0;
+}
+
+/* Rewrite the status of the record already written, if it is still in
+ * the ring, after the exec it was committed for failed */
+static void amend_status(const char *path, wrp_status_t status) {
+  struct history_header hdr;
+  int8_t value = (int8_t)status;
+
+  int fd = open(path, O_RDWR | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  if (flock(fd, LOCK_EX) == 0) {
+    if (load_header(fd, &hdr) && hdr.count > history_state.index &&
+        hdr.count - history_state.index <= hdr.capacity) {
+      off_t slot = (off_t)(history_state.index % hdr.capacity);
+      off_t off = (off_t)sizeof(hdr) +
+                  slot * (off_t)sizeof(struct history_record) +
+                  (off_t)offsetof(struct history_record, status);
+      if (pwrite(fd, &value, sizeof(value), off) != (ssize_t)sizeof(value)) {
+        log_debug("Failed to update launch history record");
+      }
+    }
+    flock(fd, LOCK_UN);
+  }
+  close(fd);
+}
+
+static void commit_record(wrp_status_t status) {
+  struct history_record *rec = &history_state.record;
+  struct history_header hdr;
+  char path[PATH_MAX];
+  const char *env;
+
+  if (!history_state.base_dir) {
+    return;
+  }
+
+  if (history_state.committed) {
+    if (history_state.written && status != WRP_OK && rec->status == WRP_OK &&
+        path_join(path, sizeof(path), history_state.base_dir, HISTORY_FILE,
+                  NULL) == WRP_OK) {
+      rec->status = (int8_t)status;
+      amend_status(path, status);
+    }
+    return;
+  }
+  history_state.committed = 1;
+
+  env = secure_getenv("PYB_HISTORY");
+  if (env && *env == '0') {
+    return;
+  }
+
+  if (path_join(path, sizeof(path), history_state.base_dir, HISTORY_FILE,
+                NULL) != WRP_OK) {
+    return;
+  }
+
+  rec->timestamp = (uint64_t)time(NULL);
+  rec->payload_hash = hash_payload();
+  rec->total_us = clamp_us(trace_now_us() - history_state.start_us);
+  rec->status = (int8_t)status;
+
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    log_debug("Failed to open launch history %s: %s", path, strerror(errno));
+    return;
+  }
+
+  if (flock(fd, LOCK_EX) == 0) {
+    load_header(fd, &hdr);
+
+    off_t slot = (off_t)(hdr.count % hdr.capacity);
+    off_t off = (off_t)sizeof(hdr) + slot * (off_t)sizeof(*rec);
+    if (pwrite(fd, rec, sizeof(*rec), off) == (ssize_t)sizeof(*rec)) {
+      history_state.written = 1;
+      history_state.index = hdr.count;
+      hdr.count++;
+      if (pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        log_debug("Failed to update launch history header");
+      }
+    }
+    flock(fd, LOCK_UN);
+  }
+  close(fd);
+}
+
+void history_commit(wrp_status_t status) {
+  /* Callers report the failure they are recording from errno afterwards */
+  int saved_errno = errno;
+  commit_record(status);
+  errno = saved_errno;
+}
+
+/* Report helpers */
+
+static int compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of a sorted array */
+static uint32_t percentile(const uint32_t *sorted, size_t n, unsigned pct) {
+  size_t rank = (pct * n + 99) / 100;
+  return sorted[rank ? rank - 1 : 0];
+}
+
+static void print_distribution(const char *name, uint32_t *values, size_t n) {
+  if (n == 0) {
+    printf("  %-14s %6zu\n", name, n);
+    return;
+  }
+
+  qsort(values, n, sizeof(*values), compare_u32);
+  printf("  %-14s %6zu %9.2f %9.2f %9.2f %9.2f\n", name, n,
+         percentile(values, n, 50) / 1000.0, percentile(values, n, 90) / 1000.0,
+         percentile(values, n, 99) / 1000.0, values[n - 1] / 1000.0);
+}
+
+static void format_date(char *buf, size_t size, uint64_t timestamp) {
+  time_t t = (time_t)timestamp;
+  struct tm tm_info;
+
+  localtime_r(&t, &tm_info);
+  strftime(buf, size, "%Y-%m-%d %H:%M", &tm_info);
+}
+
+/* Read the records in chronological order; returns how many were read */
+static size_t load_records(int fd, const struct history_header *hdr,
+                           struct history_record *records) {
+  size_t n = hdr->count < hdr->capacity ? (size_t)hdr->count : hdr->capacity;
+  size_t first = hdr->count < hdr->capacity ? 0 : hdr->count % hdr->capacity;
+
+  for (size_t i = 0; i < n; i++) {
+    size_t slot = (first + i) % hdr->capacity;
+    off_t off = (off_t)sizeof(*hdr) + (off_t)(slot * sizeof(*records));
+    if (pread(fd, &records[i], sizeof(*records), off) !=
+        (ssize_t)sizeof(*records)) {
+      return i;
+    }
+  }
+  return n;
+}
+
+wrp_status_t history_report(const char *base_dir) {
+  struct history_header hdr;
+  struct history_record *records = NULL;
+  uint32_t *values = NULL;
+  char path[PATH_MAX];
+  char first[32], last[32];
+  size_t n, k;
+  wrp_status_t status;
+
+  status = path_join(path, sizeof(path), base_dir, HISTORY_FILE, NULL);
+  if (status != WRP_OK) {
+    return handle_error(status, NULL, NULL,
+                        "Failed to construct launch history path");
+  }
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      printf("No launches recorded yet (%s)\n", path);
+      return WRP_OK;
+    }
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to open launch history: %s", path);
+  }
+
+  flock(fd, LOCK_SH);
+  if (!load_header(fd, &hdr)) {
+    close(fd);
+    return handle_error(WRP_EINVAL, NULL, NULL,
+                        "Unrecognised launch history file: %s", path);
+  }
+
+  records = calloc(hdr.capacity, sizeof(*records));
+  values = calloc(hdr.capacity, sizeof(*values));
+  if (!records || !values) {
+    close(fd);
+    free(records);
+    free(values);
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to allocate launch history buffers");
+  }
+
+  n = load_records(fd, &hdr, records);
+  flock(fd, LOCK_UN);
+  close(fd);
+
+  if (n == 0) {
+    printf("No launches recorded yet (%s)\n", path);
+    free(records);
+    free(values);
+    return WRP_OK;
+  }
+
+  format_date(first, sizeof(first), records[0].timestamp);
+  format_date(last, sizeof(last), records[n - 1].timestamp);
+  printf("Launch history: %s\n", path);
+  printf("  %zu of %llu launches, %s to %s\n\n", n,
+         (unsigned long long)hdr.count, first, last);
+
+  /* Path mix */
+  size_t path_counts[HISTORY_PATH_COUNT] = {0};
+  size_t failures = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (records[i].path < HISTORY_PATH_COUNT) {
+      path_counts[records[i].path]++;
+    }
+    failures += records[i].status != WRP_OK;
+  }
+  printf("  paths:");
+  for (int p = 0; p < HISTORY_PATH_COUNT; p++) {
+    printf(" %s %zu (%.1f%%)%s", path_names[p], path_counts[p],
+           100.0 * (double)path_counts[p] / (double)n,
+           p + 1 < HISTORY_PATH_COUNT ? "," : "");
+  }
+  printf("\n  failed launches: %zu\n\n", failures);
+
+  /* Timing distributions, in milliseconds */
+  printf("  %-14s %6s %9s %9s %9s %9s  (ms)\n", "phase", "runs", "p50", "p90",
+         "p99", "max");
+  for (size_t i = 0; i < n; i++) {
+    values[i] = records[i].total_us;
+  }
+  print_distribution("total", values, n);
+
+  for (int p = 0; p < HISTORY_PATH_COUNT; p++) {
+    char label[32];
+    k = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (records[i].path == p) {
+        values[k++] = records[i].total_us;
+      }
+    }
+    snprintf(label, sizeof(label), "total/%s", path_names[p]);
+    print_distribution(label, values, k);
+  }
+
+  for (int ph = 0; ph < HISTORY_PHASE_COUNT; ph++) {
+    k = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (records[i].phases & (1u << ph)) {
+        values[k++] = records[i].phase_us[ph];
+      }
+    }
+    print_distribution(phase_names[ph], values, k);
+  }
+
+  /* Per-payload breakdown, so a slow release stands out */
+  printf("\n  %-16s %8s %6s %6s %9s %9s  %s\n", "payload", "launches",
+         "cold", "repair", "p50 ms", "p95 ms", "first seen");
+  for (size_t i = 0; i < n; i++) {
+    uint64_t hash = records[i].payload_hash;
+    size_t cold = 0, repair = 0, seen = 0;
+
+    /* Only report each payload at its first appearance */
+    for (size_t j = 0; j < i && !seen; j++) {
+      seen = records[j].payload_hash == hash;
+    }
+    if (seen) {
+      continue;
+    }
+
+    k = 0;
+    for (size_t j = i; j < n; j++) {
+      if (records[j].payload_hash == hash) {
+        values[k++] = records[j].total_us;
+        cold += records[j].path == HISTORY_COLD;
+        repair += records[j].path == HISTORY_REPAIR;
+      }
+    }
+    qsort(values, k, sizeof(*values), compare_u32);
+    format_date(first, sizeof(first), records[i].timestamp);
+    printf("  %016llx %8zu %6zu %6zu %9.2f %9.2f  %s\n",
+           (unsigned long long)hash, k, cold, repair,
+           percentile(values, k, 50) / 1000.0,
+           percentile(values, k, 95) / 1000.0, first);
+  }
+
+  free(records);
+  free(values);
+  return WRP_OK;
+}
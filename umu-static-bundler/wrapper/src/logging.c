@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -20,16 +21,41 @@ static const char *level_symbols[] = {[LOG_DEBUG] = "[*]",
                                       [LOG_WARNING] = "[!]",
                                       [LOG_ERROR] = "[-]"};
 
+/* Longest formatted message; longer ones are truncated */
+#define LOG_LINE_MAX 1024
+
+/* PYB_LOG_FILE records are batched here and written when full, on errors,
+ * at exit and before exec */
+#define LOG_SINK_SIZE (64 * 1024)
+
 /* Current logging configuration */
 static struct {
   log_level_t min_level;
   int use_colors;
   int initialized;
   int debug_enabled; /* Runtime debug control */
+  int sink_fd;       /* PYB_LOG_FILE descriptor, or -1 */
 } log_config = {.min_level = LOG_INFO,
                 .use_colors = 1,
                 .initialized = 0,
-                .debug_enabled = 0};
+                .debug_enabled = 0,
+                .sink_fd = -1};
+
+/* Pending file sink records */
+static struct {
+  char data[LOG_SINK_SIZE];
+  size_t used;
+} log_sink;
+
+/* Timestamp text is only rebuilt when the second changes. The UTC offset is
+ * taken once at first use, so the time zone database is read at most once
+ * per process. */
+static struct {
+  time_t second;
+  long gmtoff;
+  int ready;
+  char text[32];
+} log_clock;
 
 /* Logging configuration setters/getters */
 void log_set_level(log_level_t level) {
@@ -45,6 +71,39 @@ log_level_t log_get_level(void) { return log_config.min_level; }
 
 int log_get_colors(void) { return log_config.use_colors; }
 
+/* Write out pending file sink records */
+void log_flush(void) {
+  size_t done = 0;
+
+  while (log_config.sink_fd >= 0 && done < log_sink.used) {
+    ssize_t n =
+        write(log_config.sink_fd, log_sink.data + done, log_sink.used - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += (size_t)n;
+  }
+  log_sink.used = 0;
+}
+
+/* Open the PYB_LOG_FILE sink, if requested */
+static void log_open_sink(void) {
+  const char *path = secure_getenv("PYB_LOG_FILE");
+
+  if (!path || !*path || log_config.sink_fd >= 0) {
+    return;
+  }
+
+  log_config.sink_fd =
+      open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+  if (log_config.sink_fd >= 0) {
+    atexit(log_flush);
+  }
+}
+
 /* Initialize logging system */
 void log_init(log_level_t min_level, int use_colors) {
   const char *debug_env = secure_getenv("PYB_DEBUG");
@@ -57,53 +116,128 @@ void log_init(log_level_t min_level, int use_colors) {
 
   log_set_level(min_level);
   log_set_colors(use_colors);
+  log_open_sink();
 }
 
-/* Internal function to write log message */
-static void write_log(log_level_t level, const char *fmt, va_list args) {
-  /* Skip if message level is below minimum level */
-  if (level < log_config.min_level) {
-    return;
+/* Current wall-clock time as "YYYY-MM-DD HH:MM:SS" */
+static const char *log_timestamp(void) {
+  struct timespec ts;
+  struct tm tm_info;
+
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  if (log_clock.ready && ts.tv_sec == log_clock.second) {
+    return log_clock.text;
   }
 
-  /* Skip debug messages if debug not enabled at runtime */
-  if (level == LOG_DEBUG && !log_config.debug_enabled) {
+  if (!log_clock.ready) {
+    localtime_r(&ts.tv_sec, &tm_info);
+    log_clock.gmtoff = tm_info.tm_gmtoff;
+    log_clock.ready = 1;
+  }
+
+  time_t local = ts.tv_sec + log_clock.gmtoff;
+  gmtime_r(&local, &tm_info);
+  strftime(log_clock.text, sizeof(log_clock.text), "%Y-%m-%d %H:%M:%S",
+           &tm_info);
+  log_clock.second = ts.tv_sec;
+  return log_clock.text;
+}
+
+/* Append one record to the file sink */
+static void sink_record(log_level_t level, const char *msg, size_t len) {
+  char head[64];
+  int head_len = snprintf(head, sizeof(head), "%s %s [%d] ",
+                          level_symbols[level], log_timestamp(), (int)getpid());
+
+  if (head_len < 0) {
     return;
   }
+  if (log_sink.used + (size_t)head_len + len + 1 > sizeof(log_sink.data)) {
+    log_flush();
+  }
+  if ((size_t)head_len + len + 1 > sizeof(log_sink.data)) {
+    return;
+  }
+
+  memcpy(log_sink.data + log_sink.used, head, (size_t)head_len);
+  log_sink.used += (size_t)head_len;
+  memcpy(log_sink.data + log_sink.used, msg, len);
+  log_sink.used += len;
+  log_sink.data[log_sink.used++] = '\n';
+
+  if (level == LOG_ERROR) {
+    log_flush();
+  }
+}
 
+/* Internal function to write log message */
+static void write_log(log_level_t level, const char *fmt, va_list args) {
   if (!log_config.initialized) {
     log_init(LOG_INFO, 1);
   }
 
-  /* Buffer for timestamp */
-  char timestamp[32];
-  time_t now = time(NULL);
-  struct tm *tm_info = localtime(&now);
-  strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
+  /* The file sink takes every level; stderr honours the configured one */
+  int to_stderr = level >= log_config.min_level &&
+                  (level != LOG_DEBUG || log_config.debug_enabled);
+  int to_sink = log_config.sink_fd >= 0;
 
-  /* Write log entry */
-  if (log_config.use_colors) {
-    fprintf(stderr, "%s%s ", level_colors[level], level_symbols[level]);
+  if (!to_stderr && !to_sink) {
+    return;
+  }
+
+  /* Format once, then emit each destination without further copies */
+  char msg[LOG_LINE_MAX];
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-    vfprintf(stderr, fmt, args);
+  int len = vsnprintf(msg, sizeof(msg), fmt, args);
 #pragma GCC diagnostic pop
-    fprintf(stderr, "\033[0m\n");
+  if (len < 0) {
+    return;
+  }
+  if ((size_t)len >= sizeof(msg)) {
+    len = sizeof(msg) - 1;
+  }
+
+  if (to_sink) {
+    sink_record(level, msg, (size_t)len);
+  }
+
+  if (!to_stderr) {
+    return;
+  }
+
+  /* One writev per record so lines from concurrent launches stay whole */
+  char prefix[64];
+  struct iovec iov[3];
+  int prefix_len;
+
+  if (log_config.use_colors) {
+    prefix_len = snprintf(prefix, sizeof(prefix), "%s%s ", level_colors[level],
+                          level_symbols[level]);
   } else {
-    fprintf(stderr, "%s %s ", level_symbols[level], timestamp);
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-    vfprintf(stderr, fmt, args);
-#pragma GCC diagnostic pop
-    fprintf(stderr, "\n");
+    prefix_len = snprintf(prefix, sizeof(prefix), "%s %s ",
+                          level_symbols[level], log_timestamp());
   }
+  if (prefix_len < 0) {
+    return;
+  }
+
+  static char color_reset[] = "\033[0m\n";
+  iov[0] = (struct iovec){prefix, (size_t)prefix_len};
+  iov[1] = (struct iovec){msg, (size_t)len};
+  iov[2] = log_config.use_colors ? (struct iovec){color_reset, 5}
+                                 : (struct iovec){color_reset + 4, 1};
+
+  /* Nowhere left to report a failed log write */
+  ssize_t written = writev(STDERR_FILENO, iov, 3);
+  (void)written;
 }
 
 /* Public logging functions */
 #ifndef NDEBUG
 void _log_debug(const char *fmt, ...) {
-  /* Skip if debug not enabled at runtime */
-  if (!log_config.debug_enabled) {
+  /* Skip if debug is off at runtime and there is no file sink to catch it */
+  if (!log_config.debug_enabled && log_config.sink_fd < 0) {
     return;
   }
 
@@ -1,32 +1,55 @@
+#include "history.h"
 #include "logging.h"
+#include "stats.h"
+#include "trace.h"
 #include "wrapper.h"
 #include "wrapper_config.h" /* Generated during build */
 
 int main(int argc, char *argv[]) {
   struct wrapper_config config;
+  struct trace_span span;
   wrp_status_t status;
+  int exit_code;
+
+  history_begin();
 
 #ifndef NDEBUG
   log_init(LOG_DEBUG, 1); /* Enable debug output in debug builds */
 #else
   log_init(LOG_INFO, 1); /* Default to info level for release */
 #endif
+  trace_init();
+  stats_init();
 
   /* Initialize wrapper configuration using build-time constants */
+  trace_begin(&span, "init_wrapper_config");
   status = init_wrapper_config(&config, BINARY_NAME, PYTHON_VERSION,
                                VERSION_FILE, VERSION_CHECKSUM);
+  history_phase(HISTORY_PHASE_CONFIG, trace_end(&span));
 
   if (status != WRP_OK) {
     log_error("Failed to initialize wrapper configuration");
     return EXIT_FAILURE;
   }
 
+  history_set_dir(config.paths.base_dir);
+
+  /* Summarise earlier launches instead of running the application */
+  if (argc > 1 && strcmp(argv[1], "--pyb-stats") == 0) {
+    status = history_report(config.paths.base_dir);
+    return status == WRP_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
   /* Execute the wrapped application */
-  status = run_wrapped_application(&config, argc, argv);
-  if (status != WRP_OK) {
+  exit_code = run_wrapped_application(&config, argc, argv);
+
+  /* Returning at all means the launch failed. The result is a wrp_status_t
+   * from the checks before exec, or an exit status once exec was tried. */
+  history_commit(exit_code < 0 ? (wrp_status_t)exit_code : WRP_EERRNO);
+  if (exit_code != WRP_OK) {
     /* exec_python_script was unsuccessful - convert error code to exit status
      */
-    return (status == WRP_EERRNO) ? errno : EXIT_FAILURE;
+    return (exit_code == WRP_EERRNO) ? errno : EXIT_FAILURE;
   }
 
   /* Should never reach here as exec replaces process */
@@ -0,0 +1,287 @@
+#include "pathscan.h"
+#include "logging.h"
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+/* One bit per name byte, plus room for the end boundary and a lookahead word */
+#define SCAN_WORDS (PATH_MAX / 64 + 2)
+
+/* Per-byte classification of a name, one bit per byte */
+struct scan_bitmap {
+  uint64_t slash[SCAN_WORDS];
+  uint64_t dot[SCAN_WORDS];
+  uint64_t ctrl[SCAN_WORDS];
+};
+
+struct scan_kernel {
+  const char *name;
+  unsigned (*scan)(const unsigned char *s, size_t len);
+  int (*supported)(void);
+};
+
+/* Reference implementation, one component at a time */
+static unsigned scan_scalar(const unsigned char *s, size_t len) {
+  unsigned flags = 0;
+  size_t comp_start = 0;
+
+  if (len > 0 && s[0] == '/') {
+    flags |= SCAN_ABSOLUTE;
+  }
+
+  for (size_t i = 0; i <= len; i++) {
+    if (i < len) {
+      unsigned char c = s[i];
+      if (c < 0x20 || c == 0x7f) {
+        flags |= SCAN_CONTROL;
+      }
+      if (c != '/') {
+        continue;
+      }
+      if (i > 0 && s[i - 1] == '/') {
+        flags |= SCAN_DOUBLE_SLASH;
+      }
+    }
+
+    size_t comp_len = i - comp_start;
+    if (comp_len == 1 && s[comp_start] == '.') {
+      flags |= SCAN_DOT;
+    } else if (comp_len == 2 && s[comp_start] == '.' &&
+               s[comp_start + 1] == '.') {
+      flags |= SCAN_DOTDOT;
+    }
+    comp_start = i + 1;
+  }
+
+  return flags;
+}
+
+static int always_supported(void) { return 1; }
+
+#ifdef HAVE_X86_KERNELS
+
+/* Turn the classification bitmaps into findings. Bit i stands for byte i;
+ * the name is bounded by a virtual separator before byte 0 and at byte len. */
+static unsigned evaluate_bitmap(struct scan_bitmap *bm, size_t len) {
+  size_t words = len / 64 + 1;
+  uint64_t found_dot = 0, found_dotdot = 0, found_double = 0, found_ctrl = 0;
+
+  /* Treat the end of the name as a separator */
+  bm->slash[len / 64] |= (uint64_t)1 << (len % 64);
+
+  for (size_t w = 0; w < words; w++) {
+    uint64_t s = bm->slash[w];
+    uint64_t d = bm->dot[w];
+    uint64_t s_prev = w ? bm->slash[w - 1] >> 63 : 1;
+    uint64_t s_next = bm->slash[w + 1];
+    uint64_t d_next = bm->dot[w + 1];
+
+    uint64_t after_sep = (s << 1) | s_prev;
+    uint64_t sep_next1 = (s >> 1) | (s_next << 63);
+    uint64_t sep_next2 = (s >> 2) | (s_next << 62);
+    uint64_t dot_next1 = (d >> 1) | (d_next << 63);
+
+    found_dot |= d & after_sep & sep_next1;
+    found_dotdot |= d & after_sep & dot_next1 & sep_next2;
+    found_ctrl |= bm->ctrl[w];
+
+    /* The end marker and the virtual leading separator are not real slashes */
+    uint64_t real = s & ~(w == len / 64 ? (uint64_t)1 << (len % 64) : 0);
+    uint64_t real_prev = w ? bm->slash[w - 1] >> 63 : 0;
+    found_double |= real & ((real << 1) | real_prev);
+  }
+
+  unsigned flags = 0;
+  if (found_dot)
+    flags |= SCAN_DOT;
+  if (found_dotdot)
+    flags |= SCAN_DOTDOT;
+  if (found_double)
+    flags |= SCAN_DOUBLE_SLASH;
+  if (found_ctrl)
+    flags |= SCAN_CONTROL;
+  if (len > 0 && (bm->slash[0] & 1))
+    flags |= SCAN_ABSOLUTE;
+  return flags;
+}
+
+static void clear_bitmap(struct scan_bitmap *bm, size_t len) {
+  size_t words = len / 64 + 2;
+  memset(bm->slash, 0, words * sizeof(uint64_t));
+  memset(bm->dot, 0, words * sizeof(uint64_t));
+  memset(bm->ctrl, 0, words * sizeof(uint64_t));
+}
+
+static inline void set_bits(uint64_t *map, size_t pos, uint64_t bits) {
+  map[pos / 64] |= bits << (pos % 64);
+}
+
+/* 16 bytes per step; bytes <= 0x1f via unsigned min, DEL compared directly */
+static void classify_sse2(const unsigned char *s, size_t len,
+                          struct scan_bitmap *bm) {
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i dot = _mm_set1_epi8('.');
+  const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+  const __m128i del = _mm_set1_epi8(0x7f);
+  unsigned char tail[16];
+  size_t i = 0;
+
+  for (;;) {
+    __m128i v;
+    if (i + 16 <= len) {
+      v = _mm_loadu_si128((const __m128i *)(s + i));
+    } else if (i < len) {
+      /* Pad with a byte that matches nothing */
+      memset(tail, 'a', sizeof(tail));
+      memcpy(tail, s + i, len - i);
+      v = _mm_loadu_si128((const __m128i *)tail);
+    } else {
+      break;
+    }
+
+    __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl_max), v);
+    __m128i ctrl = _mm_or_si128(low, _mm_cmpeq_epi8(v, del));
+
+    set_bits(bm->slash, i,
+             (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, slash)));
+    set_bits(bm->dot, i, (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, dot)));
+    set_bits(bm->ctrl, i, (uint32_t)_mm_movemask_epi8(ctrl));
+    i += 16;
+  }
+}
+
+__attribute__((target("avx2"))) static void
+classify_avx2(const unsigned char *s, size_t len, struct scan_bitmap *bm) {
+  const __m256i slash = _mm256_set1_epi8('/');
+  const __m256i dot = _mm256_set1_epi8('.');
+  const __m256i ctrl_max = _mm256_set1_epi8(0x1f);
+  const __m256i del = _mm256_set1_epi8(0x7f);
+  unsigned char tail[32];
+  size_t i = 0;
+
+  for (;;) {
+    __m256i v;
+    if (i + 32 <= len) {
+      v = _mm256_loadu_si256((const __m256i *)(s + i));
+    } else if (i < len) {
+      memset(tail, 'a', sizeof(tail));
+      memcpy(tail, s + i, len - i);
+      v = _mm256_loadu_si256((const __m256i *)tail);
+    } else {
+      break;
+    }
+
+    __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl_max), v);
+    __m256i ctrl = _mm256_or_si256(low, _mm256_cmpeq_epi8(v, del));
+
+    set_bits(bm->slash, i,
+             (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, slash)));
+    set_bits(bm->dot, i,
+             (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, dot)));
+    set_bits(bm->ctrl, i, (uint32_t)_mm256_movemask_epi8(ctrl));
+    i += 32;
+  }
+}
+
+static unsigned scan_sse2(const unsigned char *s, size_t len) {
+  struct scan_bitmap bm;
+  clear_bitmap(&bm, len);
+  classify_sse2(s, len, &bm);
+  return evaluate_bitmap(&bm, len);
+}
+
+static unsigned scan_avx2(const unsigned char *s, size_t len) {
+  struct scan_bitmap bm;
+  clear_bitmap(&bm, len);
+  classify_avx2(s, len, &bm);
+  return evaluate_bitmap(&bm, len);
+}
+
+static int avx2_supported(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+/* Preferred kernels first */
+static const struct scan_kernel kernels[] = {
+#ifdef HAVE_X86_KERNELS
+    {"avx2", scan_avx2, avx2_supported},
+    {"sse2", scan_sse2, always_supported}, /* Baseline on x86-64 */
+#endif
+    {"scalar", scan_scalar, always_supported},
+};
+
+static const struct scan_kernel *active_kernel;
+
+static const struct scan_kernel *get_kernel(void) {
+  if (!active_kernel) {
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+      if (kernels[i].supported()) {
+        active_kernel = &kernels[i];
+        break;
+      }
+    }
+    log_debug("Using %s archive name scanner", active_kernel->name);
+  }
+  return active_kernel;
+}
+
+const char *path_scan_impl(void) { return get_kernel()->name; }
+
+wrp_status_t path_scan_select(const char *impl) {
+  if (!impl) {
+    return PATH_INVALID;
+  }
+
+  for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+    if (strcmp(kernels[i].name, impl) == 0 && kernels[i].supported()) {
+      active_kernel = &kernels[i];
+      return PATH_OK;
+    }
+  }
+  return PATH_INVALID;
+}
+
+wrp_status_t path_scan_entry(const char *name, size_t len, const char *section,
+                             struct path_scan *scan) {
+  const char *rel;
+  size_t rel_len, section_len;
+
+  if (!name || !section || !scan) {
+    return PATH_INVALID;
+  }
+  if (len >= PATH_MAX) {
+    return PATH_TOOLONG;
+  }
+
+  /* Skip leading ./ from both, as path_strip_archive_prefix does */
+  scan->rel_offset = (len >= 2 && name[0] == '.' && name[1] == '/') ? 2 : 0;
+  scan->length = len;
+  if (strncmp(section, "./", 2) == 0) {
+    section += 2;
+  }
+
+  rel = name + scan->rel_offset;
+  rel_len = len - scan->rel_offset;
+  scan->flags = get_kernel()->scan((const unsigned char *)rel, rel_len);
+
+  /* Section match on the raw bytes; names needing normalization are left to
+   * the slow path anyway */
+  section_len = strlen(section);
+  if (section_len > 0 && section[section_len - 1] == '/') {
+    section_len--;
+  }
+  if (rel_len < section_len || memcmp(rel, section, section_len) != 0 ||
+      (rel_len > section_len && rel[section_len] != '/')) {
+    scan->flags |= SCAN_OUTSIDE;
+  } else if (rel_len == section_len) {
+    scan->flags |= SCAN_SECTION_ROOT;
+  }
+
+  return PATH_OK;
+}
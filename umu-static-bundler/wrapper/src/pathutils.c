@@ -1,5 +1,6 @@
 #include "pathutils.h"
 #include "logging.h"
+#include "stats.h"
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -39,7 +40,7 @@ wrp_status_t remove_directory_recursive(const char *path) {
     return handle_error(WRP_EINVAL, NULL, NULL, "Invalid path parameter");
   }
 
-  dc.dir = opendir(path);
+  dc.dir = stats_opendir(path);
   if (!dc.dir) {
     return (errno == ENOENT)
                ? WRP_OK
@@ -58,7 +59,7 @@ wrp_status_t remove_directory_recursive(const char *path) {
                           path, entry->d_name);
     }
 
-    if (lstat(filepath, &statbuf) != 0) {
+    if (stats_lstat(filepath, &statbuf) != 0) {
       return handle_error(WRP_EERRNO, cleanup_dir, &dc,
                           "Failed to stat file: %s", filepath);
     }
@@ -69,7 +70,7 @@ wrp_status_t remove_directory_recursive(const char *path) {
         return handle_error(status, cleanup_dir, &dc,
                             "Failed to remove subdirectory: %s", filepath);
       }
-    } else if (unlink(filepath) != 0) {
+    } else if (stats_unlink(filepath) != 0) {
       return handle_error(WRP_EERRNO, cleanup_dir, &dc,
                           "Failed to remove file: %s", filepath);
     }
@@ -77,7 +78,7 @@ wrp_status_t remove_directory_recursive(const char *path) {
 
   cleanup_dir(&dc);
 
-  if (rmdir(path) != 0 && errno != ENOENT) {
+  if (stats_rmdir(path) != 0 && errno != ENOENT) {
     return handle_error(WRP_EERRNO, NULL, NULL,
                         "Failed to remove directory: %s", path);
   }
@@ -119,7 +120,7 @@ wrp_status_t create_directory_with_parents(const char *path, mode_t mode) {
   }
 
   /* Create directory */
-  if (mkdir(path, mode) != 0 && errno != EEXIST) {
+  if (stats_mkdir(path, mode) != 0 && errno != EEXIST) {
     return handle_error(WRP_EERRNO, NULL, NULL,
                         "Failed to create directory: %s", path);
   }
@@ -194,7 +195,7 @@ wrp_status_t atomic_replace_directory(const char *old_dir, const char *new_dir,
     }
 
     if (exists) {
-      char *real_backup = realpath(backup_dir, NULL);
+      char *real_backup = stats_realpath(backup_dir, NULL);
       if (real_backup) {
         if (strcmp(real_backup, old_dir) != 0) {
           log_debug("Removing existing backup directory: %s", backup_dir);
@@ -234,7 +235,7 @@ wrp_status_t atomic_replace_directory(const char *old_dir, const char *new_dir,
       }
 
       log_debug("Moving current to backup: %s -> %s", old_dir, backup_dir);
-      if (rename(old_dir, backup_dir) != 0) {
+      if (stats_rename(old_dir, backup_dir) != 0) {
         return handle_error(WRP_EERRNO, NULL, NULL,
                             "Failed to backup current installation: %s -> %s",
                             old_dir, backup_dir);
@@ -244,7 +245,7 @@ wrp_status_t atomic_replace_directory(const char *old_dir, const char *new_dir,
 
   /* Move new to current */
   log_debug("Moving new to target: %s -> %s", new_dir, old_dir);
-  if (rename(new_dir, old_dir) != 0) {
+  if (stats_rename(new_dir, old_dir) != 0) {
     status = handle_error(WRP_EERRNO, NULL, NULL,
                           "Failed to move new installation: %s -> %s", new_dir,
                           old_dir);
@@ -253,7 +254,7 @@ wrp_status_t atomic_replace_directory(const char *old_dir, const char *new_dir,
       status = path_exists(backup_dir, &exists);
       if (status == WRP_OK && exists) {
         log_debug("Restore attempt: %s -> %s", backup_dir, old_dir);
-        rename(backup_dir, old_dir);
+        stats_rename(backup_dir, old_dir);
       }
     }
     return status;
@@ -306,7 +307,7 @@ wrp_status_t path_directory_exists(const char *path, int *exists) {
     return PATH_INVALID;
   }
 
-  *exists = (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+  *exists = (stats_stat(path, &st) == 0 && S_ISDIR(st.st_mode));
   return PATH_OK;
 }
 
@@ -337,13 +338,13 @@ wrp_status_t path_create_temp_dir(char *path, size_t size, const char *base_dir,
   }
 
   /* Create temporary directory */
-  if (!mkdtemp(template)) {
+  if (!stats_mkdtemp(template)) {
     log_error("Failed to create temporary directory: %s", strerror(errno));
     return WRP_EERRNO;
   }
 
   if (strlen(template) >= size) {
-    rmdir(template); /* Clean up on error */
+    stats_rmdir(template); /* Clean up on error */
     return PATH_TOOLONG;
   }
 
@@ -361,7 +362,7 @@ wrp_status_t path_cleanup_temp_dir(const char *path) {
     return PATH_INVALID;
   }
 
-  dir = opendir(path);
+  dir = stats_opendir(path);
   if (!dir) {
     if (errno == ENOENT) {
       return PATH_OK;
@@ -380,20 +381,20 @@ wrp_status_t path_cleanup_temp_dir(const char *path) {
       return PATH_TOOLONG;
     }
 
-    if (lstat(full_path, &st) != 0) {
+    if (stats_lstat(full_path, &st) != 0) {
       continue;
     }
 
     if (S_ISDIR(st.st_mode)) {
       path_cleanup_temp_dir(full_path);
-      rmdir(full_path);
+      stats_rmdir(full_path);
     } else {
-      unlink(full_path);
+      stats_unlink(full_path);
     }
   }
 
   closedir(dir);
-  rmdir(path);
+  stats_rmdir(path);
 
   return PATH_OK;
 }
@@ -548,7 +549,7 @@ wrp_status_t path_exists(const char *path, int *exists) {
   if (!path || !exists) {
     return WRP_EINVAL;
   }
-  *exists = (access(path, F_OK) == 0);
+  *exists = (stats_access(path, F_OK) == 0);
   return PATH_OK;
 }
 
@@ -556,7 +557,7 @@ wrp_status_t path_is_readable(const char *path, int *is_readable) {
   if (!path || !is_readable) {
     return WRP_EINVAL;
   }
-  *is_readable = (access(path, R_OK) == 0);
+  *is_readable = (stats_access(path, R_OK) == 0);
   return WRP_OK;
 }
 
@@ -565,7 +566,7 @@ wrp_status_t path_is_directory(const char *path, int *is_dir) {
   if (!path || !is_dir) {
     return WRP_EINVAL;
   }
-  if (stat(path, &st) != 0) {
+  if (stats_stat(path, &st) != 0) {
     *is_dir = 0;
     return (errno == ENOENT) ? PATH_OK : WRP_EERRNO;
   }
@@ -578,7 +579,7 @@ wrp_status_t path_is_executable(const char *path, int *is_exec) {
   if (!path || !is_exec) {
     return WRP_EINVAL;
   }
-  if (stat(path, &st) != 0) {
+  if (stats_stat(path, &st) != 0) {
     *is_exec = 0;
     return (errno == ENOENT) ? PATH_OK : WRP_EERRNO;
   }
@@ -938,7 +939,7 @@ wrp_status_t path_is_symlink(const char *path, int *is_symlink) {
     return WRP_EINVAL;
   }
 
-  if (lstat(path, &st) != 0) {
+  if (stats_lstat(path, &st) != 0) {
     if (errno == ENOENT) {
       *is_symlink = 0;
       return PATH_OK;
@@ -957,7 +958,7 @@ wrp_status_t path_readlink(char *dest, size_t size, const char *path) {
     return WRP_EINVAL;
   }
 
-  len = readlink(path, dest, size - 1);
+  len = stats_readlink(path, dest, size - 1);
   if (len == -1) {
     return WRP_EERRNO;
   }
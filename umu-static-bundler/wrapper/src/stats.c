@@ -0,0 +1,254 @@
+#include "stats.h"
+#include "logging.h"
+
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+/* Distinct span names kept; later ones are dropped */
+#define STATS_MAX_PHASES 24
+
+static const char *counter_names[STATS_COUNTER_COUNT] = {
+    [STATS_WALL] = "wall",
+    [STATS_TASK_CLOCK] = "task-clock",
+    [STATS_MINFLT] = "minor-faults",
+    [STATS_MAJFLT] = "major-faults",
+    [STATS_CTXSW] = "context-switches",
+    [STATS_INSTRUCTIONS] = "instructions"};
+
+/* perf_event_open type and config for each counter; wall has none */
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} counter_events[STATS_COUNTER_COUNT] = {
+    [STATS_TASK_CLOCK] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    [STATS_MINFLT] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MIN},
+    [STATS_MAJFLT] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS_MAJ},
+    [STATS_CTXSW] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    [STATS_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}};
+
+struct stats_phase {
+  const char *name;
+  unsigned calls;
+  struct stats_sample delta;
+};
+
+static struct {
+  int enabled;
+  int reported;
+  int fds[STATS_COUNTER_COUNT]; /* perf event fds, -1 if not available */
+  int user_only;                /* Instructions exclude the kernel */
+  uint32_t syscalls[STATS_SYS_COUNT];
+  struct stats_sample start;
+  struct stats_phase phases[STATS_MAX_PHASES];
+  size_t phase_count;
+} stats_state;
+
+int stats_enabled(void) { return stats_state.enabled; }
+
+void stats_count(stats_sys_t category) { stats_state.syscalls[category]++; }
+
+static int open_counter(uint32_t type, uint64_t config, int exclude_kernel) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = exclude_kernel;
+  attr.exclude_hv = exclude_kernel;
+
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                      PERF_FLAG_FD_CLOEXEC);
+}
+
+void stats_init(void) {
+  const char *env = secure_getenv("PYB_STATS");
+
+  if (!env || *env != '1' || stats_state.enabled) {
+    return;
+  }
+
+  for (int c = 0; c < STATS_COUNTER_COUNT; c++) {
+    stats_state.fds[c] = -1;
+    if (c == STATS_WALL) {
+      continue;
+    }
+    stats_state.fds[c] =
+        open_counter(counter_events[c].type, counter_events[c].config, 0);
+    /* With perf_event_paranoid >= 2 only user-space counts are allowed.
+     * That is still meaningful for instructions, but the software events
+     * fire in kernel context, so those fall back to getrusage instead. */
+    if (stats_state.fds[c] < 0 && c == STATS_INSTRUCTIONS) {
+      stats_state.fds[c] =
+          open_counter(counter_events[c].type, counter_events[c].config, 1);
+      stats_state.user_only = stats_state.fds[c] >= 0;
+    }
+    if (stats_state.fds[c] < 0) {
+      log_debug("perf counter %s unavailable: %s", counter_names[c],
+                strerror(errno));
+    }
+  }
+
+  stats_state.enabled = 1;
+  stats_sample(&stats_state.start);
+  atexit(stats_report);
+}
+
+void stats_sample(struct stats_sample *sample) {
+  struct rusage ru;
+  struct timespec ts;
+  int have_rusage = 0;
+
+  if (!stats_state.enabled) {
+    return;
+  }
+
+  memcpy(sample->syscalls, stats_state.syscalls, sizeof(sample->syscalls));
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  sample->counters[STATS_WALL] =
+      (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+
+  for (int c = STATS_TASK_CLOCK; c < STATS_COUNTER_COUNT; c++) {
+    uint64_t value = 0;
+
+    if (stats_state.fds[c] >= 0 &&
+        read(stats_state.fds[c], &value, sizeof(value)) ==
+            (ssize_t)sizeof(value)) {
+      sample->counters[c] = value;
+      continue;
+    }
+    if (c == STATS_INSTRUCTIONS) {
+      sample->counters[c] = 0;
+      continue;
+    }
+
+    if (!have_rusage) {
+      getrusage(RUSAGE_SELF, &ru);
+      have_rusage = 1;
+    }
+    switch (c) {
+    case STATS_TASK_CLOCK:
+      value = ((uint64_t)ru.ru_utime.tv_sec + (uint64_t)ru.ru_stime.tv_sec) *
+                  1000000000ull +
+              ((uint64_t)ru.ru_utime.tv_usec + (uint64_t)ru.ru_stime.tv_usec) *
+                  1000ull;
+      break;
+    case STATS_MINFLT:
+      value = (uint64_t)ru.ru_minflt;
+      break;
+    case STATS_MAJFLT:
+      value = (uint64_t)ru.ru_majflt;
+      break;
+    case STATS_CTXSW:
+      value = (uint64_t)ru.ru_nvcsw + (uint64_t)ru.ru_nivcsw;
+      break;
+    }
+    sample->counters[c] = value;
+  }
+}
+
+static void sample_delta(struct stats_sample *out,
+                         const struct stats_sample *start,
+                         const struct stats_sample *end) {
+  for (int c = 0; c < STATS_COUNTER_COUNT; c++) {
+    out->counters[c] = end->counters[c] - start->counters[c];
+  }
+  for (int s = 0; s < STATS_SYS_COUNT; s++) {
+    out->syscalls[s] = end->syscalls[s] - start->syscalls[s];
+  }
+}
+
+void stats_record(const char *name, const struct stats_sample *start) {
+  struct stats_sample now, delta;
+  struct stats_phase *phase = NULL;
+
+  if (!stats_state.enabled) {
+    return;
+  }
+
+  stats_sample(&now);
+  sample_delta(&delta, start, &now);
+
+  for (size_t i = 0; i < stats_state.phase_count; i++) {
+    if (strcmp(stats_state.phases[i].name, name) == 0) {
+      phase = &stats_state.phases[i];
+      break;
+    }
+  }
+  if (!phase) {
+    if (stats_state.phase_count == STATS_MAX_PHASES) {
+      return;
+    }
+    phase = &stats_state.phases[stats_state.phase_count++];
+    phase->name = name;
+  }
+
+  phase->calls++;
+  for (int c = 0; c < STATS_COUNTER_COUNT; c++) {
+    phase->delta.counters[c] += delta.counters[c];
+  }
+  for (int s = 0; s < STATS_SYS_COUNT; s++) {
+    phase->delta.syscalls[s] += delta.syscalls[s];
+  }
+}
+
+static void print_row(const char *name, unsigned calls,
+                      const struct stats_sample *d) {
+  char instr[16];
+
+  if (stats_state.fds[STATS_INSTRUCTIONS] >= 0) {
+    snprintf(instr, sizeof(instr), "%.2f",
+             (double)d->counters[STATS_INSTRUCTIONS] / 1e6);
+  } else {
+    snprintf(instr, sizeof(instr), "-");
+  }
+
+  fprintf(stderr,
+          "  %-26s %5u %9.2f %9.2f %7llu %6llu %6llu %9s %5u %5u %5u %6u "
+          "%6u\n",
+          name, calls, (double)d->counters[STATS_WALL] / 1e6,
+          (double)d->counters[STATS_TASK_CLOCK] / 1e6,
+          (unsigned long long)d->counters[STATS_MINFLT],
+          (unsigned long long)d->counters[STATS_MAJFLT],
+          (unsigned long long)d->counters[STATS_CTXSW], instr,
+          d->syscalls[STATS_SYS_OPEN], d->syscalls[STATS_SYS_STAT],
+          d->syscalls[STATS_SYS_MKDIR], d->syscalls[STATS_SYS_RENAME],
+          d->syscalls[STATS_SYS_REMOVE]);
+}
+
+void stats_report(void) {
+  struct stats_sample now, total;
+
+  if (!stats_state.enabled || stats_state.reported) {
+    return;
+  }
+  stats_state.reported = 1;
+
+  stats_sample(&now);
+  sample_delta(&total, &stats_state.start, &now);
+
+  fprintf(stderr, "PYB_STATS pid %d, counters from:", (int)getpid());
+  for (int c = STATS_TASK_CLOCK; c < STATS_COUNTER_COUNT; c++) {
+    const char *source = "perf";
+    if (stats_state.fds[c] < 0) {
+      source = c == STATS_INSTRUCTIONS ? "unavailable" : "rusage";
+    } else if (c == STATS_INSTRUCTIONS && stats_state.user_only) {
+      source = "perf, user only";
+    }
+    fprintf(stderr, " %s (%s)%s", counter_names[c], source,
+            c + 1 < STATS_COUNTER_COUNT ? "," : "\n");
+  }
+  fprintf(stderr,
+          "  %-26s %5s %9s %9s %7s %6s %6s %9s %5s %5s %5s %6s %6s\n",
+          "phase", "calls", "wall ms", "task ms", "minflt", "majflt", "ctxsw",
+          "instr M", "open", "stat", "mkdir", "rename", "remove");
+  for (size_t i = 0; i < stats_state.phase_count; i++) {
+    const struct stats_phase *phase = &stats_state.phases[i];
+    print_row(phase->name, phase->calls, &phase->delta);
+  }
+  print_row("total", 1, &total);
+  fflush(stderr);
+}
@@ -0,0 +1,121 @@
+#include "trace.h"
+#include "logging.h"
+
+#include <stdarg.h>
+#include <time.h>
+
+/* Enough for an event with a short args object */
+#define TRACE_EVENT_MAX 512
+
+static struct {
+  int fd;
+  pid_t pid;
+} trace_state = {.fd = -1, .pid = 0};
+
+int trace_enabled(void) { return trace_state.fd >= 0; }
+
+uint64_t trace_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+}
+
+void trace_init(void) {
+  const char *path = secure_getenv("PYB_TRACE");
+
+  if (!path || !*path || trace_state.fd >= 0) {
+    return;
+  }
+
+  /* Whoever creates the file writes the array opener; everyone else appends */
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd >= 0) {
+    if (write(fd, "[\n", 2) != 2) {
+      close(fd);
+      fd = -1;
+    }
+  } else if (errno == EEXIST) {
+    fd = open(path, O_WRONLY | O_APPEND | O_CLOEXEC);
+  }
+
+  if (fd < 0) {
+    log_warning("Failed to open trace file %s: %s", path, strerror(errno));
+    return;
+  }
+
+  trace_state.fd = fd;
+  trace_state.pid = getpid();
+  log_debug("Writing trace events to: %s", path);
+}
+
+/* Write one event line. O_APPEND and a single write() keep lines from
+ * concurrent launches intact. */
+static void write_event(const char *name, char phase, uint64_t ts,
+                        const char *args) {
+  char line[TRACE_EVENT_MAX];
+  int len;
+
+  len = snprintf(line, sizeof(line),
+                 "{\"name\":\"%s\",\"cat\":\"wrapper\",\"ph\":\"%c\","
+                 "\"ts\":%llu,\"pid\":%d,\"tid\":%d%s%s%s%s},\n",
+                 name, phase, (unsigned long long)ts, (int)trace_state.pid,
+                 (int)trace_state.pid, phase == 'i' ? ",\"s\":\"p\"" : "",
+                 args ? ",\"args\":{" : "", args ? args : "", args ? "}" : "");
+  if (len < 0 || (size_t)len >= sizeof(line)) {
+    return;
+  }
+
+  if (write(trace_state.fd, line, (size_t)len) != len) {
+    log_debug("Short write to trace file, disabling tracing");
+    trace_close();
+  }
+}
+
+void trace_begin(struct trace_span *span, const char *name) {
+  span->name = name;
+  span->start_us = trace_now_us();
+  if (trace_state.fd >= 0) {
+    write_event(name, 'B', span->start_us, NULL);
+  }
+  stats_sample(&span->stats);
+}
+
+uint64_t trace_end(struct trace_span *span) {
+  stats_record(span->name, &span->stats);
+  uint64_t now = trace_now_us();
+  if (trace_state.fd >= 0) {
+    write_event(span->name, 'E', now, NULL);
+  }
+  return now - span->start_us;
+}
+
+uint64_t trace_end_args(struct trace_span *span, const char *fmt, ...) {
+  stats_record(span->name, &span->stats);
+  uint64_t now = trace_now_us();
+  if (trace_state.fd >= 0) {
+    char args[TRACE_EVENT_MAX / 2];
+    va_list ap;
+    va_start(ap, fmt);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    int len = vsnprintf(args, sizeof(args), fmt, ap);
+#pragma GCC diagnostic pop
+    va_end(ap);
+    write_event(span->name, 'E', now,
+                (len >= 0 && (size_t)len < sizeof(args)) ? args : NULL);
+  }
+  return now - span->start_us;
+}
+
+void trace_instant(const char *name) {
+  if (trace_state.fd >= 0) {
+    write_event(name, 'i', trace_now_us(), NULL);
+  }
+}
+
+void trace_close(void) {
+  if (trace_state.fd >= 0) {
+    close(trace_state.fd);
+    trace_state.fd = -1;
+  }
+}
@@ -1,10 +1,22 @@
+#include "history.h"
 #include "locking.h"
 #include "logging.h"
 #include "pathutils.h"
+#include "stats.h"
+#include "trace.h"
 #include "wrapper.h"
+#include "wrapper_config.h" /* Generated during build */
+
+#include <signal.h>
 
 extern char **environ;
 
+/* Lines -X importtime writes to stderr start with this */
+#define IMPORT_TIME_PREFIX "import time:"
+
+/* Set by setup_import_profile; exec_python_script then adds -X importtime */
+static int import_profile_enabled;
+
 /* Process context cleanup */
 struct process_cleanup {
   char **argv;
@@ -45,7 +57,7 @@ static wrp_status_t needs_version_update(const char *app_dir,
                         "Failed to construct version file path");
   }
 
-  f = fopen(version_path, "rb");
+  f = stats_fopen(version_path, "rb");
   if (!f) {
     if (errno == ENOENT) {
       log_debug("Version file not found: %s", version_path);
@@ -97,22 +109,34 @@ wrp_status_t exec_python_script(const char *python_path,
                         script_path);
   }
 
-  pc.argv = malloc(sizeof(char *) * (argc + 2));
+  pc.argv = malloc(sizeof(char *) * (argc + 4));
   if (!pc.argv) {
     return handle_error(WRP_EERRNO, NULL, NULL,
                         "Failed to allocate memory for exec argv");
   }
 
-  /* Build new argument array */
-  pc.argv[0] = (char *)python_path;
-  pc.argv[1] = (char *)script_path;
-  memcpy(pc.argv + 2, argv + 1, (argc - 1) * sizeof(char *));
-  pc.argv[argc + 1] = NULL;
+  /* Build new argument array. -X importtime, unlike its environment form,
+   * only applies to this interpreter and not to the Pythons it starts. */
+  int n = 0;
+  pc.argv[n++] = (char *)python_path;
+  if (import_profile_enabled) {
+    pc.argv[n++] = (char *)"-X";
+    pc.argv[n++] = (char *)"importtime";
+  }
+  pc.argv[n++] = (char *)script_path;
+  memcpy(pc.argv + n, argv + 1, (argc - 1) * sizeof(char *));
+  pc.argv[n + argc - 1] = NULL;
 
   log_debug("Executing Python: %s %s", python_path, script_path);
+  history_commit(WRP_OK);
+  trace_instant("execve");
+  trace_close();
+  stats_report();
+  log_flush();
   execve(python_path, pc.argv, environ);
 
   /* Only reached if execve fails */
+  history_commit(WRP_EERRNO);
   return handle_error(WRP_EERRNO, cleanup_process, &pc,
                       "Failed to execute Python interpreter");
 }
@@ -368,6 +392,7 @@ wrp_status_t verify_app_install(const char *app_dir,
 /* Ensure components are properly installed */
 wrp_status_t ensure_components(const struct wrapper_config *config) {
   struct process_cleanup pc = {.lock_fd = -1};
+  struct trace_span span;
   char exe_path[PATH_MAX];
   wrp_status_t status;
   int needs_python = 0;
@@ -390,9 +415,11 @@ retry:
   }
 
   /* Determine what needs updating */
+  trace_begin(&span, "verify_python_install");
   status =
       verify_python_install(config->paths.python_dir,
                             config->meta.python_version, &needs_python_repair);
+  history_phase(HISTORY_PHASE_VERIFY, trace_end(&span));
   if (status == WRP_ENOENT) {
     if (needs_python_repair) {
       log_info("Python installation needs repair: %s",
@@ -406,8 +433,10 @@ retry:
     return status;
   }
 
+  trace_begin(&span, "verify_app_install");
   status = verify_app_install(config->paths.app_dir, &config->meta,
                               &needs_app_repair);
+  history_phase(HISTORY_PHASE_VERIFY, trace_end(&span));
   if (status == WRP_ENOENT) {
     if (needs_app_repair) {
       log_info("Application installation needs repair: %s",
@@ -426,9 +455,22 @@ retry:
     return WRP_OK;
   }
 
+  /* Classify the launch by what the first pass found */
+  if (retry_count == 0) {
+    if (needs_python_repair || needs_app_repair) {
+      history_set_path(HISTORY_REPAIR);
+    } else if (needs_python && needs_app) {
+      history_set_path(HISTORY_COLD);
+    } else {
+      history_set_path(HISTORY_UPGRADE);
+    }
+  }
+
   /* Acquire installation lock */
+  trace_begin(&span, "lock_wait");
   pc.lock_fd = acquire_lock_safe(config->paths.lock_file, exe_path,
                                  config->meta.timeout);
+  history_phase(HISTORY_PHASE_LOCK, trace_end(&span));
   if (pc.lock_fd == -1) {
     return handle_error(WRP_ELOCK, NULL, NULL,
                         "Failed to acquire installation lock after %d seconds",
@@ -437,7 +479,9 @@ retry:
 
   /* Create clean temporary directory */
   log_debug("Setting up temporary directory: %s", config->paths.temp_dir);
+  trace_begin(&span, "cleanup_tmp");
   status = remove_directory_recursive(config->paths.temp_dir);
+  history_phase(HISTORY_PHASE_CLEANUP, trace_end(&span));
   if (status != WRP_OK && status != WRP_ENOENT) {
     return handle_error(status, cleanup_process, &pc,
                         "Failed to clean temporary directory");
@@ -445,9 +489,11 @@ retry:
 
   /* Extract required components */
   log_debug("Extracting components to: %s", config->paths.temp_dir);
+  trace_begin(&span, "extract_bundled_archive");
   status = extract_bundled_archive(exe_path, config->paths.temp_dir,
                                    (needs_python ? INSTALL_PYTHON : 0) |
                                        (needs_app ? INSTALL_APP : 0));
+  history_phase(HISTORY_PHASE_EXTRACT, trace_end(&span));
 
   if (status != WRP_OK) {
     remove_directory_recursive(config->paths.temp_dir);
@@ -485,8 +531,13 @@ retry:
                           "Failed to construct Python backup path");
     }
 
+    trace_begin(&span, "atomic_replace_directory");
     status = atomic_replace_directory(config->paths.python_dir, temp_python_dir,
                                       backup_dir);
+    history_phase(HISTORY_PHASE_INSTALL,
+                  trace_end_args(&span,
+                                 "\"component\":\"python\",\"status\":%d",
+                                 status));
     if (status != WRP_OK) {
       remove_directory_recursive(config->paths.temp_dir);
       return handle_error(status, cleanup_process, &pc,
@@ -513,8 +564,13 @@ retry:
                           "Failed to construct app backup path");
     }
 
+    trace_begin(&span, "atomic_replace_directory");
     status = atomic_replace_directory(config->paths.app_dir, temp_app_dir,
                                       backup_dir);
+    history_phase(HISTORY_PHASE_INSTALL,
+                  trace_end_args(&span,
+                                 "\"component\":\"app\",\"status\":%d",
+                                 status));
     if (status != WRP_OK) {
       remove_directory_recursive(config->paths.temp_dir);
       return handle_error(status, cleanup_process, &pc,
@@ -533,8 +589,193 @@ retry:
   return WRP_OK;
 }
 
+static void write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+}
+
+/* Copy in_fd to err_fd, diverting -X importtime lines to profile_fd until
+ * the first other line. The startup imports are reported by then; from there
+ * on everything, including the times of later lazy imports, passes straight
+ * through until pyb_stderr.pth restores the real stderr. Only the first few bytes of a line are ever held back, until it
+ * is clear which way it goes, so prompts and progress output pass through
+ * unchanged. */
+static void filter_import_times(int in_fd, int err_fd, int profile_fd) {
+  const size_t prefix_len = sizeof(IMPORT_TIME_PREFIX) - 1;
+  char buf[BUFFER_SIZE * 2];
+  size_t used = 0;
+  int line_fd = -1; /* Where the rest of the current line goes, if decided */
+  int diverting = 1;
+
+  for (;;) {
+    ssize_t n = read(in_fd, buf + used, sizeof(buf) - used);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    if (!diverting) {
+      write_all(err_fd, buf, (size_t)n);
+      continue;
+    }
+    used += (size_t)n;
+
+    size_t start = 0;
+    while (start < used) {
+      const char *line = buf + start;
+      const char *nl = memchr(line, '\n', used - start);
+      size_t len = nl ? (size_t)(nl - line) + 1 : used - start;
+
+      if (line_fd < 0) {
+        size_t cmp = len < prefix_len ? len : prefix_len;
+        if (memcmp(line, IMPORT_TIME_PREFIX, cmp) != 0) {
+          line_fd = err_fd;
+        } else if (len > prefix_len) {
+          line_fd = profile_fd;
+        } else if (!nl && used < sizeof(buf)) {
+          break; /* Too short to tell yet */
+        } else {
+          line_fd = err_fd;
+        }
+      }
+
+      if (line_fd == err_fd) {
+        /* The application's own output: stop looking at lines */
+        write_all(err_fd, line, used - start);
+        start = used;
+        diverting = 0;
+        close(profile_fd);
+        break;
+      }
+
+      write_all(line_fd, line, len);
+      if (nl) {
+        line_fd = -1;
+      }
+      start += len;
+    }
+
+    memmove(buf, buf + start, used - start);
+    used -= start;
+  }
+
+  if (used > 0) {
+    write_all(line_fd >= 0 ? line_fd : err_fd, buf, used);
+  }
+}
+
+/* PYB_PROFILE_IMPORTS=1: make the interpreter report import times (see
+ * exec_python_script) and divert that report from stderr into a file under
+ * base_dir. A forked filter process keeps the real stderr and passes
+ * everything else through. The real stderr is also passed down as
+ * PYB_STDERR_FD, which pyb_stderr.pth puts back onto fd 2 before the
+ * interpreter starts any other program; the filter exits once the pipe is
+ * closed. Without site (python -S or -I) stderr stays a pipe for the whole
+ * launch. */
+static wrp_status_t setup_import_profile(const char *base_dir) {
+  const char *env = secure_getenv("PYB_PROFILE_IMPORTS");
+  char profile_dir[PATH_MAX];
+  char profile_path[PATH_MAX];
+  char name[32];
+  int fds[2];
+  wrp_status_t status;
+
+  if (!env || *env != '1') {
+    return WRP_OK;
+  }
+
+  /* The pid survives execve, so each launch gets its own file */
+  snprintf(name, sizeof(name), "importtime-%d.txt", (int)getpid());
+  status = path_join(profile_dir, sizeof(profile_dir), base_dir,
+                     IMPORT_PROFILE_SUBDIR, NULL);
+  if (status == WRP_OK) {
+    status = path_join(profile_path, sizeof(profile_path), profile_dir, name,
+                       NULL);
+  }
+  if (status != WRP_OK) {
+    return handle_error(status, NULL, NULL,
+                        "Failed to construct import profile path");
+  }
+
+  status = path_ensure_directory(profile_dir, 0700);
+  if (status != WRP_OK) {
+    return handle_error(status, NULL, NULL,
+                        "Failed to create import profile directory: %s",
+                        profile_dir);
+  }
+
+  int profile_fd =
+      stats_open(profile_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (profile_fd < 0) {
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to open import profile: %s", profile_path);
+  }
+
+  if (pipe2(fds, O_CLOEXEC) != 0) {
+    close(profile_fd);
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to create import profile pipe");
+  }
+
+  log_flush();
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(profile_fd);
+    close(fds[0]);
+    close(fds[1]);
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to start import profile filter");
+  }
+
+  if (pid == 0) {
+    /* Keep passing stderr through when the terminal sends ^C or ^\ */
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    close(fds[1]);
+    filter_import_times(fds[0], STDERR_FILENO, profile_fd);
+    _exit(0);
+  }
+
+  close(fds[0]);
+  close(profile_fd);
+
+  /* The real stderr, kept open across execve for pyb_stderr.pth */
+  char fd_name[16];
+  int stderr_fd = fcntl(STDERR_FILENO, F_DUPFD, 3);
+  if (stderr_fd < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
+    if (stderr_fd >= 0) {
+      close(stderr_fd);
+    }
+    close(fds[1]);
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to redirect stderr for import profiling");
+  }
+  close(fds[1]);
+
+  snprintf(fd_name, sizeof(fd_name), "%d", stderr_fd);
+  if (setenv("PYB_STDERR_FD", fd_name, 1) != 0) {
+    return handle_error(WRP_EERRNO, NULL, NULL,
+                        "Failed to pass on stderr for import profiling");
+  }
+  import_profile_enabled = 1;
+
+  log_debug("Writing import profile to: %s", profile_path);
+  return WRP_OK;
+}
+
 /* Set up the Python environment variables */
-wrp_status_t setup_python_environment(const char *app_dir,
+wrp_status_t setup_python_environment(const char *base_dir,
+                                      const char *app_dir,
                                       const char *python_dir) {
   char python_path[PATH_MAX];
   char python_bin[PATH_MAX];
@@ -544,7 +785,7 @@ wrp_status_t setup_python_environment(const char *app_dir,
   wrp_status_t status;
   int printed;
 
-  if (!app_dir || !python_dir) {
+  if (!base_dir || !app_dir || !python_dir) {
     return handle_error(WRP_EINVAL, NULL, NULL,
                         "Invalid parameters for environment setup");
   }
@@ -590,5 +831,15 @@ wrp_status_t setup_python_environment(const char *app_dir,
                         "Failed to set environment variables");
   }
 
-  return WRP_OK;
+  /* An interpreter built with mimalloc only uses it when asked to. A
+   * PYTHONMALLOC from the user (e.g. "debug") takes precedence. Ours is
+   * marked so that pyb_malloc.pth drops it once the interpreter has started,
+   * before any other Python inherits it. */
+  if (PYTHON_MALLOC[0] != '\0' && !secure_getenv("PYTHONMALLOC") &&
+      (setenv("PYTHONMALLOC", PYTHON_MALLOC, 1) != 0 ||
+       setenv("PYB_SET_PYTHONMALLOC", "1", 1) != 0)) {
+    return handle_error(WRP_EERRNO, NULL, NULL, "Failed to set PYTHONMALLOC");
+  }
+
+  return setup_import_profile(base_dir);
 }
@@ -0,0 +1,692 @@
+/* Streaming payload packer
+ *
+ * Writes the bundle payload straight from the source trees named in a
+ * manifest, so nothing is copied into a staging directory first. Each
+ * manifest line maps a source file or directory to its archive path, with
+ * an optional octal mode for the file (or every file under the directory):
+ *
+ *   <source path>\t<archive path>[\t<mode>]
+ *
+ * Blank lines and lines starting with '#' are skipped. Directories are
+ * walked recursively and symlinks are stored as symlinks.
+ *
+ * The output only depends on the mapped content: entries are sorted by
+ * archive path with missing parent directories added, owned by 0:0 without
+ * names, given 0755/0644 permissions (from the owner execute bit) unless a
+ * mode is set, and stamped with one mtime, $SOURCE_DATE_EPOCH or 0.
+ *
+ * The archive ends in a skippable frame recording the settings it was
+ * packed with (see PAYLOAD_PROFILE_MAGIC). With -w the wrapper is written
+ * first and the %020d archive size trailer follows the archive, so the
+ * finished executable comes out of one pass.
+ *
+ * Usage: pack -m manifest -o output [-w wrapper] [-l level] [-L window-log]
+ *             [-F per-file|max=<bytes>] [-T threads] [-r contents]
+ *
+ *   -l  zstd level (default 22)
+ *   -L  long distance matching with a 2^n byte window, 0 for off (default)
+ *   -F  start a new frame for every file, or after <bytes> of input
+ *   -T  zstd worker threads, 0 for one per CPU (default 0)
+ *   -r  list every entry as "<archive path>\t<f|d|l>\t<bytes>\t<estimate>",
+ *       the estimate being the file compressed on its own at
+ *       PACK_ESTIMATE_LEVEL (the archive is one stream, so what each file
+ *       costs in it can only be estimated)
+ */
+#include "wrapper.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <zstd.h>
+
+#define PACK_CHUNK (256 * 1024)
+#define PACK_ESTIMATE_LEVEL 3
+
+struct pack_entry {
+  char *name;   /* Archive path; directories end in '/' */
+  char *source; /* Source path, NULL for added parent directories */
+  char *link;   /* Symlink target */
+  mode_t type;  /* AE_IFREG, AE_IFDIR or AE_IFLNK */
+  mode_t perm;
+  int64_t size;
+};
+
+struct pack_list {
+  struct pack_entry *entries;
+  size_t count;
+  size_t capacity;
+};
+
+/* Compressed bytes written, for the trailer */
+struct pack_output {
+  int fd;
+  unsigned long long bytes;
+};
+
+/* Where -r goes, and the context that estimates each file's share */
+struct pack_contents {
+  FILE *file;
+  ZSTD_CCtx *cctx;
+  unsigned char *scratch;
+};
+
+/* zstd settings, also recorded in the profile frame */
+struct pack_options {
+  int level;
+  int window_log;
+  const char *frames; /* NULL, "per-file" or "max=<bytes>" */
+  int threads;
+};
+
+static wrp_status_t pack_fail(wrp_status_t status, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static wrp_status_t pack_fail(wrp_status_t status, const char *fmt, ...) {
+  va_list ap;
+
+  fprintf(stderr, "pack: ");
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+  return status;
+}
+
+static wrp_status_t pack_push(struct pack_list *list, char *name,
+                              const char *source, mode_t type, mode_t perm,
+                              int64_t size, const char *link) {
+  struct pack_entry *entry;
+
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+    struct pack_entry *grown =
+        realloc(list->entries, capacity * sizeof(*list->entries));
+    if (!grown) {
+      free(name);
+      return pack_fail(WRP_EERRNO, "out of memory");
+    }
+    list->entries = grown;
+    list->capacity = capacity;
+  }
+
+  entry = &list->entries[list->count];
+  entry->name = name;
+  entry->source = source ? strdup(source) : NULL;
+  entry->link = link ? strdup(link) : NULL;
+  entry->type = type;
+  entry->perm = perm;
+  entry->size = size;
+  if ((source && !entry->source) || (link && !entry->link)) {
+    free(entry->source);
+    free(entry->link);
+    free(entry->name);
+    return pack_fail(WRP_EERRNO, "out of memory");
+  }
+  list->count++;
+  return WRP_OK;
+}
+
+/* Add source (a file, symlink or directory tree) as archive path dest */
+static wrp_status_t pack_add_tree(struct pack_list *list, const char *source,
+                                  const char *dest, int mode) {
+  struct stat st;
+  char *name;
+  wrp_status_t status;
+
+  if (lstat(source, &st) != 0) {
+    return pack_fail(WRP_EERRNO, "%s: %s", source, strerror(errno));
+  }
+
+  if (S_ISREG(st.st_mode)) {
+    mode_t perm = mode >= 0                ? (mode_t)mode
+                  : (st.st_mode & S_IXUSR) ? 0755
+                                           : 0644;
+    if (!(name = strdup(dest))) {
+      return pack_fail(WRP_EERRNO, "out of memory");
+    }
+    return pack_push(list, name, source, AE_IFREG, perm, st.st_size, NULL);
+  }
+
+  if (S_ISLNK(st.st_mode)) {
+    char target[PATH_MAX];
+    ssize_t len = readlink(source, target, sizeof(target) - 1);
+    if (len < 0) {
+      return pack_fail(WRP_EERRNO, "%s: %s", source, strerror(errno));
+    }
+    target[len] = '\0';
+    if (!(name = strdup(dest))) {
+      return pack_fail(WRP_EERRNO, "out of memory");
+    }
+    return pack_push(list, name, source, AE_IFLNK, 0777, 0, target);
+  }
+
+  if (!S_ISDIR(st.st_mode)) {
+    return pack_fail(WRP_EINVAL, "%s: not a file, symlink or directory",
+                     source);
+  }
+
+  if (asprintf(&name, "%s/", dest) < 0) {
+    return pack_fail(WRP_EERRNO, "out of memory");
+  }
+  status = pack_push(list, name, source, AE_IFDIR, 0755, 0, NULL);
+  if (status != WRP_OK) {
+    return status;
+  }
+
+  DIR *dir = opendir(source);
+  if (!dir) {
+    return pack_fail(WRP_EERRNO, "%s: %s", source, strerror(errno));
+  }
+
+  struct dirent *de;
+  status = WRP_OK;
+  while (status == WRP_OK && (de = readdir(dir))) {
+    char child_source[PATH_MAX];
+    char child_dest[PATH_MAX];
+
+    if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+      continue;
+    }
+    if (check_path_length(snprintf(child_source, sizeof(child_source),
+                                   "%s/%s", source, de->d_name),
+                          sizeof(child_source)) != WRP_OK ||
+        check_path_length(snprintf(child_dest, sizeof(child_dest), "%s/%s",
+                                   dest, de->d_name),
+                          sizeof(child_dest)) != WRP_OK) {
+      status = pack_fail(WRP_EINVAL, "%s/%s: path too long", source,
+                         de->d_name);
+      break;
+    }
+    status = pack_add_tree(list, child_source, child_dest, mode);
+  }
+  closedir(dir);
+  return status;
+}
+
+/* Add a directory entry for each parent of a mapped path; walked trees
+ * bring their own, and duplicates are dropped after sorting */
+static wrp_status_t pack_add_parents(struct pack_list *list,
+                                     const char *dest) {
+  for (const char *slash = strchr(dest, '/'); slash;
+       slash = strchr(slash + 1, '/')) {
+    if (slash == dest + 1 && dest[0] == '.') {
+      continue; /* "./" itself */
+    }
+    char *parent = strndup(dest, (size_t)(slash - dest) + 1);
+    if (!parent) {
+      return pack_fail(WRP_EERRNO, "out of memory");
+    }
+    wrp_status_t status =
+        pack_push(list, parent, NULL, AE_IFDIR, 0755, 0, NULL);
+    if (status != WRP_OK) {
+      return status;
+    }
+  }
+  return WRP_OK;
+}
+
+/* Byte order, with mapped entries ahead of added parents of the same name */
+static int pack_compare(const void *a, const void *b) {
+  const struct pack_entry *x = a;
+  const struct pack_entry *y = b;
+  int r = strcmp(x->name, y->name);
+
+  if (r != 0) {
+    return r;
+  }
+  return (x->source == NULL) - (y->source == NULL);
+}
+
+/* Sort and drop repeated names; two mappings to one file are an error */
+static wrp_status_t pack_sort(struct pack_list *list) {
+  size_t out = 0;
+
+  qsort(list->entries, list->count, sizeof(*list->entries), pack_compare);
+  for (size_t i = 0; i < list->count; i++) {
+    struct pack_entry *entry = &list->entries[i];
+
+    if (out > 0 && strcmp(list->entries[out - 1].name, entry->name) == 0) {
+      if (entry->source && entry->type != AE_IFDIR) {
+        return pack_fail(WRP_EINVAL, "%s is mapped more than once",
+                         entry->name);
+      }
+      free(entry->name);
+      free(entry->source);
+      free(entry->link);
+      continue;
+    }
+    list->entries[out++] = *entry;
+  }
+  list->count = out;
+  return WRP_OK;
+}
+
+static wrp_status_t pack_read_manifest(struct pack_list *list,
+                                       const char *path) {
+  FILE *f = fopen(path, "r");
+  char *line = NULL;
+  size_t size = 0;
+  ssize_t len;
+  unsigned lineno = 0;
+  wrp_status_t status = WRP_OK;
+
+  if (!f) {
+    return pack_fail(WRP_EERRNO, "%s: %s", path, strerror(errno));
+  }
+
+  while (status == WRP_OK && (len = getline(&line, &size, f)) >= 0) {
+    lineno++;
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+      line[--len] = '\0';
+    }
+    if (len == 0 || line[0] == '#') {
+      continue;
+    }
+
+    char *source = line;
+    char *dest = strchr(source, '\t');
+    char *mode_str = dest ? strchr(dest + 1, '\t') : NULL;
+    int mode = -1;
+
+    if (!dest) {
+      status = pack_fail(WRP_EINVAL, "%s:%u: expected source<TAB>dest", path,
+                         lineno);
+      break;
+    }
+    *dest++ = '\0';
+    if (mode_str) {
+      char *end;
+      *mode_str++ = '\0';
+      mode = (int)strtol(mode_str, &end, 8);
+      if (*mode_str == '\0' || *end != '\0' || mode < 0 || mode > 07777) {
+        status = pack_fail(WRP_EINVAL, "%s:%u: bad mode %s", path, lineno,
+                           mode_str);
+        break;
+      }
+    }
+
+    /* Directory mappings get their trailing slash back when walked */
+    size_t dest_len = strlen(dest);
+    while (dest_len > 1 && dest[dest_len - 1] == '/') {
+      dest[--dest_len] = '\0';
+    }
+    if (*source == '\0' || *dest == '\0' || *dest == '/') {
+      status = pack_fail(WRP_EINVAL,
+                         "%s:%u: need a source and a relative archive path",
+                         path, lineno);
+      break;
+    }
+    status = pack_add_tree(list, source, dest, mode);
+    if (status == WRP_OK) {
+      status = pack_add_parents(list, dest);
+    }
+  }
+
+  free(line);
+  fclose(f);
+  return status;
+}
+
+/* Write all of buffer, counting it; returns -1 with errno set on failure */
+static int pack_write_all(struct pack_output *out, const void *buffer,
+                          size_t length) {
+  const char *p = buffer;
+  size_t left = length;
+
+  while (left > 0) {
+    ssize_t n = write(out->fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    p += n;
+    left -= (size_t)n;
+  }
+  out->bytes += length;
+  return 0;
+}
+
+static la_ssize_t pack_write_cb(struct archive *a, void *data,
+                                const void *buffer, size_t length) {
+  if (pack_write_all(data, buffer, length) < 0) {
+    archive_set_error(a, errno, "write: %s", strerror(errno));
+    return -1;
+  }
+  return (la_ssize_t)length;
+}
+
+/* Compressed size of data fed to the estimating context; ZSTD_e_end
+ * finishes the frame */
+static unsigned long long pack_estimate(struct pack_contents *contents,
+                                        const void *data, size_t size,
+                                        ZSTD_EndDirective end) {
+  ZSTD_inBuffer in = {data, size, 0};
+  unsigned long long total = 0;
+  size_t remaining;
+
+  do {
+    ZSTD_outBuffer out = {contents->scratch, ZSTD_CStreamOutSize(), 0};
+    remaining = ZSTD_compressStream2(contents->cctx, &out, &in, end);
+    if (ZSTD_isError(remaining)) {
+      return total;
+    }
+    total += out.pos;
+  } while (end == ZSTD_e_end ? remaining != 0 : in.pos < in.size);
+  return total;
+}
+
+static wrp_status_t pack_write_file(struct archive *aw,
+                                    const struct pack_entry *entry,
+                                    char *buffer,
+                                    struct pack_contents *contents,
+                                    unsigned long long *estimate) {
+  int fd = open(entry->source, O_RDONLY | O_CLOEXEC);
+  int64_t total = 0;
+  ssize_t n;
+
+  if (fd < 0) {
+    return pack_fail(WRP_EERRNO, "%s: %s", entry->source, strerror(errno));
+  }
+  while ((n = read(fd, buffer, PACK_CHUNK)) > 0) {
+    if (archive_write_data(aw, buffer, (size_t)n) != n) {
+      close(fd);
+      return pack_fail(WRP_EEXTRACT, "%s: %s", entry->source,
+                       archive_error_string(aw));
+    }
+    if (contents) {
+      *estimate += pack_estimate(contents, buffer, (size_t)n, ZSTD_e_continue);
+    }
+    total += n;
+  }
+  close(fd);
+  if (contents) {
+    *estimate += pack_estimate(contents, NULL, 0, ZSTD_e_end);
+  }
+
+  if (n < 0) {
+    return pack_fail(WRP_EERRNO, "%s: %s", entry->source, strerror(errno));
+  }
+  if (total != entry->size) {
+    return pack_fail(WRP_EINVAL, "%s changed while packing", entry->source);
+  }
+  return WRP_OK;
+}
+
+static void put_le32(unsigned char *p, uint32_t v) {
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+/* Append the skippable frame describing opts */
+static wrp_status_t pack_write_profile(struct pack_output *out,
+                                       const struct pack_options *opts) {
+  unsigned char frame[8 + PAYLOAD_PROFILE_MAX + 4];
+  int len = snprintf((char *)frame + 8, PAYLOAD_PROFILE_MAX,
+                     "codec=zstd level=%d long=%d frames=%s", opts->level,
+                     opts->window_log, opts->frames ? opts->frames : "single");
+  size_t total;
+
+  if (len < 0 || len >= PAYLOAD_PROFILE_MAX) {
+    return pack_fail(WRP_EINVAL, "profile too long");
+  }
+  total = 8 + (size_t)len + 4;
+  put_le32(frame, PAYLOAD_PROFILE_MAGIC);
+  put_le32(frame + 4, (uint32_t)len + 4);
+  put_le32(frame + 8 + len, (uint32_t)total);
+
+  if (pack_write_all(out, frame, total) < 0) {
+    return pack_fail(WRP_EERRNO, "write profile: %s", strerror(errno));
+  }
+  return WRP_OK;
+}
+
+/* Set one zstd option from a number */
+static int pack_set_option(struct archive *aw, const char *key, long value) {
+  char text[24];
+
+  snprintf(text, sizeof(text), "%ld", value);
+  return archive_write_set_filter_option(aw, "zstd", key, text);
+}
+
+static wrp_status_t pack_write_archive(const struct pack_list *list,
+                                       struct pack_output *out,
+                                       const struct pack_options *opts,
+                                       struct pack_contents *contents,
+                                       time_t mtime, unsigned long long *raw) {
+  struct archive *aw = archive_write_new();
+  struct archive_entry *entry = archive_entry_new();
+  char *buffer = malloc(PACK_CHUNK);
+  wrp_status_t status = WRP_OK;
+  int r;
+
+  *raw = 0;
+  if (!aw || !entry || !buffer) {
+    status = pack_fail(WRP_EERRNO, "out of memory");
+    goto out;
+  }
+
+  archive_write_set_format_pax_restricted(aw);
+  archive_write_add_filter_zstd(aw);
+  if (pack_set_option(aw, "compression-level", opts->level) != ARCHIVE_OK) {
+    status = pack_fail(WRP_EINVAL, "bad zstd level %d", opts->level);
+    goto out;
+  }
+  if (opts->window_log > 0 &&
+      pack_set_option(aw, "long", opts->window_log) != ARCHIVE_OK) {
+    status = pack_fail(WRP_EINVAL, "bad zstd window log %d", opts->window_log);
+    goto out;
+  }
+  if (opts->frames) {
+    if (strcmp(opts->frames, "per-file") == 0) {
+      r = archive_write_set_filter_option(aw, "zstd", "frame-per-file", "1");
+    } else if (strncmp(opts->frames, "max=", 4) == 0) {
+      r = archive_write_set_filter_option(aw, "zstd", "max-frame-in",
+                                          opts->frames + 4);
+    } else {
+      r = ARCHIVE_FAILED;
+    }
+    if (r != ARCHIVE_OK) {
+      status = pack_fail(WRP_EINVAL, "bad frame layout %s", opts->frames);
+      goto out;
+    }
+  }
+  pack_set_option(aw, "threads", opts->threads);
+  /* No padding after the last frame; the trailer follows directly */
+  archive_write_set_bytes_in_last_block(aw, 1);
+
+  if (archive_write_open2(aw, out, NULL, pack_write_cb, NULL, NULL) !=
+      ARCHIVE_OK) {
+    status =
+        pack_fail(WRP_EEXTRACT, "open archive: %s", archive_error_string(aw));
+    goto out;
+  }
+
+  for (size_t i = 0; i < list->count && status == WRP_OK; i++) {
+    const struct pack_entry *e = &list->entries[i];
+
+    archive_entry_clear(entry);
+    archive_entry_set_pathname(entry, e->name);
+    archive_entry_set_filetype(entry, e->type);
+    archive_entry_set_perm(entry, e->perm);
+    archive_entry_set_size(entry, e->type == AE_IFREG ? e->size : 0);
+    archive_entry_set_mtime(entry, mtime, 0);
+    archive_entry_set_uid(entry, 0);
+    archive_entry_set_gid(entry, 0);
+    if (e->link) {
+      archive_entry_set_symlink(entry, e->link);
+    }
+
+    unsigned long long estimate = 0;
+    if (archive_write_header(aw, entry) != ARCHIVE_OK) {
+      status = pack_fail(WRP_EEXTRACT, "%s: %s", e->name,
+                         archive_error_string(aw));
+    } else if (e->type == AE_IFREG && e->size > 0) {
+      status = pack_write_file(aw, e, buffer, contents, &estimate);
+      *raw += (unsigned long long)e->size;
+    }
+    if (contents) {
+      fprintf(contents->file, "%s\t%c\t%lld\t%llu\n", e->name,
+              e->type == AE_IFDIR ? 'd' : e->type == AE_IFLNK ? 'l' : 'f',
+              e->type == AE_IFREG ? (long long)e->size : 0LL, estimate);
+    }
+  }
+
+  if (archive_write_close(aw) != ARCHIVE_OK && status == WRP_OK) {
+    status =
+        pack_fail(WRP_EEXTRACT, "close archive: %s", archive_error_string(aw));
+  }
+  if (status == WRP_OK) {
+    status = pack_write_profile(out, opts);
+  }
+
+out:
+  archive_entry_free(entry);
+  archive_write_free(aw);
+  free(buffer);
+  return status;
+}
+
+static wrp_status_t pack_copy_wrapper(int out_fd, const char *wrapper) {
+  char buffer[BUFFER_SIZE * 16];
+  int fd = open(wrapper, O_RDONLY | O_CLOEXEC);
+  ssize_t n;
+
+  if (fd < 0) {
+    return pack_fail(WRP_EERRNO, "%s: %s", wrapper, strerror(errno));
+  }
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    if (write(out_fd, buffer, (size_t)n) != n) {
+      close(fd);
+      return pack_fail(WRP_EERRNO, "write: %s", strerror(errno));
+    }
+  }
+  close(fd);
+  return n < 0 ? pack_fail(WRP_EERRNO, "%s: %s", wrapper, strerror(errno))
+               : WRP_OK;
+}
+
+int main(int argc, char *argv[]) {
+  struct pack_list list = {0};
+  struct pack_output out = {.fd = -1};
+  struct timespec start, end;
+  const char *manifest = NULL;
+  const char *output = NULL;
+  const char *wrapper = NULL;
+  const char *contents_path = NULL;
+  const char *epoch = getenv("SOURCE_DATE_EPOCH");
+  struct pack_contents contents = {0};
+  struct pack_options opts = {.level = 22};
+  unsigned long long raw = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "m:o:w:l:L:F:T:r:")) != -1) {
+    switch (opt) {
+    case 'm':
+      manifest = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'w':
+      wrapper = optarg;
+      break;
+    case 'l':
+      opts.level = atoi(optarg);
+      break;
+    case 'L':
+      opts.window_log = atoi(optarg);
+      break;
+    case 'F':
+      opts.frames = *optarg ? optarg : NULL;
+      break;
+    case 'T':
+      opts.threads = atoi(optarg);
+      break;
+    case 'r':
+      contents_path = optarg;
+      break;
+    default:
+      manifest = NULL;
+      optind = argc;
+      break;
+    }
+  }
+  if (!manifest || !output || optind != argc) {
+    fprintf(stderr,
+            "Usage: %s -m manifest -o output [-w wrapper] [-l level] "
+            "[-L window-log] [-F per-file|max=<bytes>] [-T threads] "
+            "[-r contents]\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (pack_read_manifest(&list, manifest) != WRP_OK ||
+      pack_sort(&list) != WRP_OK) {
+    return EXIT_FAILURE;
+  }
+
+  if (contents_path) {
+    contents.file = fopen(contents_path, "we");
+    contents.cctx = ZSTD_createCCtx();
+    contents.scratch = malloc(ZSTD_CStreamOutSize());
+    if (!contents.file || !contents.cctx || !contents.scratch) {
+      pack_fail(WRP_EERRNO, "%s: %s", contents_path, strerror(errno));
+      return EXIT_FAILURE;
+    }
+    ZSTD_CCtx_setParameter(contents.cctx, ZSTD_c_compressionLevel,
+                           PACK_ESTIMATE_LEVEL);
+  }
+
+  out.fd = open(output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                wrapper ? 0755 : 0644);
+  if (out.fd < 0) {
+    pack_fail(WRP_EERRNO, "%s: %s", output, strerror(errno));
+    return EXIT_FAILURE;
+  }
+
+  wrp_status_t status = WRP_OK;
+  if (wrapper) {
+    status = pack_copy_wrapper(out.fd, wrapper);
+  }
+  if (status == WRP_OK) {
+    status = pack_write_archive(&list, &out, &opts,
+                                contents_path ? &contents : NULL,
+                                epoch ? (time_t)strtoll(epoch, NULL, 10) : 0,
+                                &raw);
+  }
+  if (contents_path) {
+    if (fclose(contents.file) != 0 && status == WRP_OK) {
+      status = pack_fail(WRP_EERRNO, "%s: %s", contents_path, strerror(errno));
+    }
+    ZSTD_freeCCtx(contents.cctx);
+    free(contents.scratch);
+  }
+  if (status == WRP_OK && wrapper &&
+      dprintf(out.fd, "%0*llu", ARCHIVE_SIZE_DIGITS, out.bytes) !=
+          ARCHIVE_SIZE_DIGITS) {
+    status = pack_fail(WRP_EERRNO, "write trailer: %s", strerror(errno));
+  }
+  if (close(out.fd) != 0 && status == WRP_OK) {
+    status = pack_fail(WRP_EERRNO, "%s: %s", output, strerror(errno));
+  }
+  if (status != WRP_OK) {
+    unlink(output);
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  fprintf(stderr,
+          "pack: %zu entries, %.1f MB -> %.1f MB (%.2fx) at zstd level %d in "
+          "%.1f s\n",
+          list.count, (double)raw / 1e6, (double)out.bytes / 1e6,
+          out.bytes ? (double)raw / (double)out.bytes : 0, opts.level,
+          (double)(end.tv_sec - start.tv_sec) +
+              (double)(end.tv_nsec - start.tv_nsec) / 1e9);
+  return EXIT_SUCCESS;
+}
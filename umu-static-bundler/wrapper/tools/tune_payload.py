@@ -0,0 +1,174 @@
+"""
+Pick the payload's compression settings by measuring them.
+
+Packs the manifest once per combination of zstd level, long distance window
+and frame layout, extracts each result with the wrapper's own code
+(extract_bench -B) and keeps the Pareto front of archive size against
+extraction time. The winner minimises
+
+    weight * size / smallest size + (1 - weight) * time / fastest time
+
+so --weight 1 picks the smallest archive and --weight 0 the fastest to
+unpack. The chosen archive is written to --output; the settings it was
+packed with are in its profile frame, which the wrapper logs under
+PYB_DEBUG.
+
+Usage: tune_payload.py --pack tools/pack --bench bench/extract_bench
+                       -m payload.manifest -o archive.tar.zst [--weight W]
+"""
+
+import argparse
+import itertools
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+TRAILER_DIGITS = 20
+
+
+def csv(kind):
+    return lambda text: [kind(item) for item in text.split(",") if item]
+
+
+def pack(args, work, level, window_log, frames):
+    """Pack one candidate as a bundle with an empty wrapper."""
+    name = f"l{level}-w{window_log}-{frames.replace('=', '')}"
+    bundle = os.path.join(work, name)
+    command = [args.pack, "-m", args.manifest, "-o", bundle,
+               "-w", os.devnull, "-l", str(level), "-L", str(window_log),
+               "-T", str(args.threads)]
+    if frames != "single":
+        command += ["-F", frames]
+    if args.contents:
+        # The listing is the same for every candidate
+        command += ["-r", args.contents]
+    start = time.perf_counter()
+    subprocess.run(command, check=True, stderr=subprocess.DEVNULL)
+    return bundle, time.perf_counter() - start
+
+
+def bench(args, bundle):
+    """Median extraction time in microseconds and peak RSS in KiB."""
+    results = bundle + ".json"
+    subprocess.run([args.bench, "-B", bundle, "-n", str(args.runs),
+                    "-t", args.target, "-o", results],
+                   check=True, stdout=subprocess.DEVNULL)
+    with open(results) as f:
+        target = json.load(f)["targets"][0]
+    os.unlink(results)
+    return target["extract_us"], target["max_rss_kb"]
+
+
+def pareto(candidates):
+    """Candidates no other one beats on both size and time."""
+    return [c for c in candidates
+            if not any(o["bytes"] <= c["bytes"] and
+                       o["extract_us"] <= c["extract_us"] and
+                       (o["bytes"], o["extract_us"]) !=
+                       (c["bytes"], c["extract_us"])
+                       for o in candidates)]
+
+
+def choose(front, weight):
+    smallest = min(c["bytes"] for c in front)
+    fastest = max(min(c["extract_us"] for c in front), 1)
+    return min(front, key=lambda c: weight * c["bytes"] / smallest +
+               (1 - weight) * c["extract_us"] / fastest)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        description="Measure payload compression settings and keep the best")
+    parser.add_argument("--pack", required=True, help="tools/pack binary")
+    parser.add_argument("--bench", required=True,
+                        help="bench/extract_bench binary")
+    parser.add_argument("-m", "--manifest", required=True,
+                        help="pack manifest")
+    parser.add_argument("-o", "--output", required=True,
+                        help="where to write the chosen archive")
+    parser.add_argument("--levels", type=csv(int), default=[9, 15, 19, 22],
+                        help="zstd levels (default 9,15,19,22)")
+    parser.add_argument("--long", type=csv(int), default=[0, 27],
+                        help="long distance window logs, 0 for off "
+                        "(default 0,27)")
+    parser.add_argument("--frames", type=csv(str),
+                        default=["single", "max=8388608"],
+                        help="frame layouts: single, per-file or "
+                        "max=<bytes> (default single,max=8388608)")
+    parser.add_argument("--weight", type=float, default=0.5,
+                        help="0 favours extraction time, 1 archive size "
+                        "(default 0.5)")
+    parser.add_argument("--target", help="directory to extract into "
+                        "(default: next to --output)")
+    parser.add_argument("-n", "--runs", type=int, default=3,
+                        help="extractions per candidate (default 3)")
+    parser.add_argument("-T", "--threads", type=int, default=0,
+                        help="pack worker threads, 0 for one per CPU")
+    parser.add_argument("--report", help="also write all results as JSON")
+    parser.add_argument("--contents",
+                        help="where pack -r lists the payload's entries")
+    args = parser.parse_args(argv)
+
+    if not 0 <= args.weight <= 1:
+        parser.error("--weight must be between 0 and 1")
+    args.target = args.target or os.path.dirname(
+        os.path.abspath(args.output))
+
+    candidates = []
+    with tempfile.TemporaryDirectory(dir=args.target) as work:
+        for level, window_log, frames in itertools.product(
+                args.levels, args.long, args.frames):
+            try:
+                bundle, pack_s = pack(args, work, level, window_log, frames)
+                extract_us, rss_kb = bench(args, bundle)
+            except subprocess.CalledProcessError as e:
+                print(f"  level {level} long {window_log} {frames}: "
+                      f"failed ({e})", file=sys.stderr)
+                continue
+            candidates.append({
+                "level": level, "long": window_log, "frames": frames,
+                "bundle": bundle,
+                "bytes": os.path.getsize(bundle) - TRAILER_DIGITS,
+                "extract_us": extract_us, "max_rss_kb": rss_kb,
+                "pack_s": round(pack_s, 2)})
+
+        if not candidates:
+            print("tune_payload: no candidate could be packed and extracted",
+                  file=sys.stderr)
+            return 1
+
+        front = pareto(candidates)
+        best = choose(front, args.weight)
+
+        print(f"  {'level':>5} {'long':>4} {'frames':<12} {'MB':>8} "
+              f"{'extract ms':>10} {'RSS MiB':>8} {'pack s':>7}")
+        for c in sorted(candidates, key=lambda c: c["bytes"]):
+            mark = "*" if c is best else "+" if c in front else " "
+            print(f"{mark} {c['level']:>5} {c['long']:>4} {c['frames']:<12} "
+                  f"{c['bytes'] / 1e6:8.2f} {c['extract_us'] / 1000:10.1f} "
+                  f"{c['max_rss_kb'] / 1024:8.1f} {c['pack_s']:7.1f}")
+        print("  + Pareto front, * chosen at weight "
+              f"{args.weight:g}")
+
+        # The archive is the bundle without its size trailer
+        with open(best["bundle"], "rb") as src, \
+                open(args.output, "wb") as dst:
+            shutil.copyfileobj(src, dst)
+            dst.truncate(best["bytes"])
+
+    if args.report:
+        for c in candidates:
+            c["pareto"] = c in front
+            del c["bundle"]
+        with open(args.report, "w") as f:
+            json.dump({"weight": args.weight, "chosen": candidates.index(best),
+                       "candidates": candidates}, f, indent=1)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())